@@ -0,0 +1,145 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "circuit_breaker.hpp"
+
+namespace mctpw
+{
+namespace internal
+{
+CircuitBreakers::CircuitBreakers(const MCTPConfiguration& config) :
+    failureThreshold(config.breakerFailureThreshold),
+    openTime(config.breakerOpenTime)
+{
+}
+
+bool CircuitBreakers::allow(DeviceID devID)
+{
+    if (!enabled())
+    {
+        return true;
+    }
+    auto it = breakers.find(devID);
+    if (it == breakers.end())
+    {
+        return true;
+    }
+    Breaker& breaker = it->second;
+    switch (breaker.state)
+    {
+        case BreakerState::closed:
+            return true;
+        case BreakerState::open:
+            if (std::chrono::steady_clock::now() - breaker.openedAt < openTime)
+            {
+                return false;
+            }
+            breaker.probing = true;
+            setState(devID, breaker, BreakerState::halfOpen);
+            return true;
+        case BreakerState::halfOpen:
+            if (breaker.probing)
+            {
+                return false;
+            }
+            breaker.probing = true;
+            return true;
+    }
+    return true;
+}
+
+void CircuitBreakers::onSuccess(DeviceID devID)
+{
+    auto it = breakers.find(devID);
+    if (it == breakers.end())
+    {
+        return;
+    }
+    // Any response shows the device is alive again. Entry is gone before the
+    // callback runs, so it may call back into the breakers
+    BreakerState previous = it->second.state;
+    breakers.erase(it);
+    if (previous != BreakerState::closed && stateChangeCallback)
+    {
+        stateChangeCallback(devID, BreakerState::closed);
+    }
+}
+
+void CircuitBreakers::onFailure(DeviceID devID)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    Breaker& breaker = breakers[devID];
+    switch (breaker.state)
+    {
+        case BreakerState::closed:
+            if (++breaker.failures >= failureThreshold)
+            {
+                breaker.openedAt = std::chrono::steady_clock::now();
+                setState(devID, breaker, BreakerState::open);
+            }
+            break;
+        case BreakerState::open:
+            break;
+        case BreakerState::halfOpen:
+            breaker.probing = false;
+            breaker.openedAt = std::chrono::steady_clock::now();
+            setState(devID, breaker, BreakerState::open);
+            break;
+    }
+}
+
+void CircuitBreakers::onAbandoned(DeviceID devID)
+{
+    auto it = breakers.find(devID);
+    if (it == breakers.end())
+    {
+        return;
+    }
+    Breaker& breaker = it->second;
+    if (breaker.state == BreakerState::halfOpen && breaker.probing)
+    {
+        // Probe again after another openTime
+        breaker.probing = false;
+        breaker.openedAt = std::chrono::steady_clock::now();
+        setState(devID, breaker, BreakerState::open);
+    }
+}
+
+BreakerState CircuitBreakers::state(DeviceID devID) const
+{
+    auto it = breakers.find(devID);
+    return it == breakers.end() ? BreakerState::closed : it->second.state;
+}
+
+void CircuitBreakers::erase(DeviceID devID)
+{
+    breakers.erase(devID);
+}
+
+void CircuitBreakers::setState(DeviceID devID, Breaker& breaker,
+                               BreakerState state)
+{
+    breaker.state = state;
+    if (stateChangeCallback)
+    {
+        stateChangeCallback(devID, state);
+    }
+}
+} // namespace internal
+} // namespace mctpw
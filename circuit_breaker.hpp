@@ -0,0 +1,80 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "mctp_wrapper.hpp"
+
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+
+namespace mctpw
+{
+namespace internal
+{
+/**
+ * @brief Circuit breaker per DeviceID.
+ *
+ * A breaker opens after failureThreshold consecutive failed requests. While
+ * open, requests are refused. After openTime one request is let through as a
+ * probe (half open). Its success closes the breaker, its failure opens it
+ * again.
+ */
+class CircuitBreakers
+{
+  public:
+    using StateChangeCallback = std::function<void(DeviceID, BreakerState)>;
+
+    explicit CircuitBreakers(const MCTPConfiguration& config);
+
+    bool enabled() const
+    {
+        return failureThreshold > 0;
+    }
+    /**
+     * @brief Check if a request to devID may be sent now. Request allowed
+     * must be followed by onSuccess or onFailure
+     */
+    bool allow(DeviceID devID);
+    void onSuccess(DeviceID devID);
+    void onFailure(DeviceID devID);
+    /* Request was refused locally. Says nothing about the device, but a
+     * probe refused this way must not keep the breaker half open */
+    void onAbandoned(DeviceID devID);
+    BreakerState state(DeviceID devID) const;
+    /* Forget state of devID without reporting a change */
+    void erase(DeviceID devID);
+
+    StateChangeCallback stateChangeCallback;
+
+  private:
+    struct Breaker
+    {
+        BreakerState state = BreakerState::closed;
+        unsigned failures = 0;
+        bool probing = false;
+        std::chrono::steady_clock::time_point openedAt{};
+    };
+
+    unsigned failureThreshold;
+    std::chrono::milliseconds openTime;
+    /* Only devices which failed recently have an entry */
+    std::unordered_map<DeviceID, Breaker> breakers;
+
+    void setState(DeviceID devID, Breaker& breaker, BreakerState state);
+};
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,330 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "endpoint_snapshot.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <phosphor-logging/log.hpp>
+#include <vector>
+
+namespace mctpw
+{
+namespace internal
+{
+namespace
+{
+constexpr uint32_t snapshotMagic = 0x5754434D; // "MCTW"
+constexpr uint16_t snapshotVersion = 1;
+
+struct Header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t messageType;
+    uint8_t bindingType;
+    uint16_t vendorId;
+    uint16_t vendorMessageType;
+    uint16_t vendorMessageTypeMask;
+    uint16_t reserved;
+    uint32_t serviceCount;
+    uint32_t endpointCount;
+    uint32_t stringTableSize;
+    uint64_t contentHash;
+} __attribute__((packed));
+
+struct ServiceRecord
+{
+    uint32_t nameOffset;
+    uint32_t uniqueNameOffset;
+    uint8_t networkID;
+    uint8_t hasNetworkID;
+    uint16_t reserved;
+} __attribute__((packed));
+
+struct EndpointRecord
+{
+    uint32_t deviceId;
+    uint32_t bus;
+    uint32_t serviceIndex;
+} __attribute__((packed));
+
+uint64_t fnv1a(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void fillConfig(Header& header, const MCTPConfiguration& config)
+{
+    header.messageType = static_cast<uint8_t>(config.type);
+    header.bindingType = static_cast<uint8_t>(config.bindingType);
+    header.vendorId = config.vendorId.value_or(0);
+    header.vendorMessageType =
+        config.vendorMessageType ? config.vendorMessageType->value : 0;
+    header.vendorMessageTypeMask =
+        config.vendorMessageType ? config.vendorMessageType->mask : 0;
+}
+
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* addr =
+                mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                data = static_cast<const uint8_t*>(addr);
+                size = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile()
+    {
+        if (data)
+        {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+} // namespace
+
+std::optional<EndpointSnapshot>
+    EndpointSnapshot::load(const std::string& path,
+                           const MCTPConfiguration& config)
+{
+    MappedFile file(path);
+    if (!file.data || file.size < sizeof(Header))
+    {
+        return std::nullopt;
+    }
+
+    Header header;
+    std::memcpy(&header, file.data, sizeof(header));
+    Header expected{};
+    fillConfig(expected, config);
+    if (header.magic != snapshotMagic || header.version != snapshotVersion ||
+        header.messageType != expected.messageType ||
+        header.bindingType != expected.bindingType ||
+        header.vendorId != expected.vendorId ||
+        header.vendorMessageType != expected.vendorMessageType ||
+        header.vendorMessageTypeMask != expected.vendorMessageTypeMask)
+    {
+        phosphor::logging::log<phosphor::logging::level::INFO>(
+            ("Endpoint snapshot " + path + " not usable for this configuration")
+                .c_str());
+        return std::nullopt;
+    }
+
+    const size_t payloadSize =
+        static_cast<size_t>(header.serviceCount) * sizeof(ServiceRecord) +
+        static_cast<size_t>(header.endpointCount) * sizeof(EndpointRecord) +
+        header.stringTableSize;
+    const uint8_t* payload = file.data + sizeof(Header);
+    if (file.size - sizeof(Header) != payloadSize ||
+        fnv1a(payload, payloadSize) != header.contentHash)
+    {
+        phosphor::logging::log<phosphor::logging::level::WARNING>(
+            ("Endpoint snapshot " + path + " is corrupted").c_str());
+        return std::nullopt;
+    }
+
+    const uint8_t* endpointBase =
+        payload + header.serviceCount * sizeof(ServiceRecord);
+    const char* strings = reinterpret_cast<const char*>(
+        endpointBase + header.endpointCount * sizeof(EndpointRecord));
+    const uint32_t stringTableSize = header.stringTableSize;
+    auto getString = [stringTableSize, strings](uint32_t offset) {
+        if (offset >= stringTableSize)
+        {
+            throw std::out_of_range("Invalid string offset");
+        }
+        return std::string(strings + offset,
+                           strnlen(strings + offset, stringTableSize - offset));
+    };
+
+    EndpointSnapshot snapshot;
+    snapshot.contentHash = header.contentHash;
+    try
+    {
+        std::vector<std::string> serviceNames;
+        for (uint32_t i = 0; i < header.serviceCount; i++)
+        {
+            ServiceRecord record;
+            std::memcpy(&record, payload + i * sizeof(ServiceRecord),
+                        sizeof(record));
+            auto name = getString(record.nameOffset);
+            ServiceInfo info;
+            info.uniqueName = getString(record.uniqueNameOffset);
+            if (record.hasNetworkID)
+            {
+                info.networkID = record.networkID;
+            }
+            snapshot.services.emplace(name, std::move(info));
+            serviceNames.emplace_back(std::move(name));
+        }
+        for (uint32_t i = 0; i < header.endpointCount; i++)
+        {
+            EndpointRecord record;
+            std::memcpy(&record, endpointBase + i * sizeof(EndpointRecord),
+                        sizeof(record));
+            DeviceID deviceId;
+            deviceId.id = record.deviceId;
+            snapshot.endpoints.emplace(
+                deviceId,
+                std::make_pair(static_cast<unsigned>(record.bus),
+                               serviceNames.at(record.serviceIndex)));
+        }
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::WARNING>(
+            ("Endpoint snapshot " + path + " is invalid. " + e.what())
+                .c_str());
+        return std::nullopt;
+    }
+    return snapshot;
+}
+
+bool EndpointSnapshot::save(const std::string& path,
+                            const MCTPConfiguration& config)
+{
+    // Keep output deterministic so that identical content gives identical
+    // hash
+    std::map<std::string, uint32_t> serviceIndex;
+    for (const auto& [name, info] : services)
+    {
+        serviceIndex.emplace(name, 0);
+    }
+    for (const auto& [deviceId, service] : endpoints)
+    {
+        serviceIndex.emplace(service.second, 0);
+    }
+
+    std::vector<uint8_t> payload(serviceIndex.size() * sizeof(ServiceRecord) +
+                                 endpoints.size() * sizeof(EndpointRecord));
+    std::string stringTable;
+    auto addString = [&stringTable](const std::string& str) {
+        uint32_t offset = static_cast<uint32_t>(stringTable.size());
+        stringTable.append(str);
+        stringTable.push_back('\0');
+        return offset;
+    };
+
+    uint32_t index = 0;
+    for (auto& [name, idx] : serviceIndex)
+    {
+        idx = index;
+        ServiceRecord record{};
+        record.nameOffset = addString(name);
+        auto it = services.find(name);
+        record.uniqueNameOffset =
+            addString(it != services.end() ? it->second.uniqueName : name);
+        if (it != services.end() && it->second.networkID)
+        {
+            record.hasNetworkID = 1;
+            record.networkID = *it->second.networkID;
+        }
+        std::memcpy(payload.data() + index * sizeof(ServiceRecord), &record,
+                    sizeof(record));
+        index++;
+    }
+
+    std::vector<std::pair<DeviceID, const std::pair<unsigned, std::string>*>>
+        sortedEndpoints;
+    for (const auto& [deviceId, service] : endpoints)
+    {
+        sortedEndpoints.emplace_back(deviceId, &service);
+    }
+    std::sort(sortedEndpoints.begin(), sortedEndpoints.end(),
+              [](const auto& lhs, const auto& rhs) {
+                  return lhs.first < rhs.first;
+              });
+    uint8_t* endpointBase =
+        payload.data() + serviceIndex.size() * sizeof(ServiceRecord);
+    for (size_t i = 0; i < sortedEndpoints.size(); i++)
+    {
+        EndpointRecord record{};
+        record.deviceId = sortedEndpoints[i].first.id;
+        record.bus = sortedEndpoints[i].second->first;
+        record.serviceIndex = serviceIndex.at(sortedEndpoints[i].second->second);
+        std::memcpy(endpointBase + i * sizeof(EndpointRecord), &record,
+                    sizeof(record));
+    }
+    payload.insert(payload.end(), stringTable.begin(), stringTable.end());
+
+    Header header{};
+    header.magic = snapshotMagic;
+    header.version = snapshotVersion;
+    fillConfig(header, config);
+    header.serviceCount = static_cast<uint32_t>(serviceIndex.size());
+    header.endpointCount = static_cast<uint32_t>(sortedEndpoints.size());
+    header.stringTableSize = static_cast<uint32_t>(stringTable.size());
+    header.contentHash = fnv1a(payload.data(), payload.size());
+    contentHash = header.contentHash;
+
+    std::string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644);
+    if (fd < 0)
+    {
+        phosphor::logging::log<phosphor::logging::level::WARNING>(
+            ("Unable to create endpoint snapshot " + tmpPath).c_str());
+        return false;
+    }
+    bool written =
+        write(fd, &header, sizeof(header)) ==
+            static_cast<ssize_t>(sizeof(header)) &&
+        write(fd, payload.data(), payload.size()) ==
+            static_cast<ssize_t>(payload.size());
+    close(fd);
+    if (!written || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        phosphor::logging::log<phosphor::logging::level::WARNING>(
+            ("Unable to write endpoint snapshot " + path).c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+} // namespace internal
+} // namespace mctpw
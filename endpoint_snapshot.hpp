@@ -0,0 +1,74 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "mctp_wrapper.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace mctpw
+{
+namespace internal
+{
+/**
+ * @brief On-disk copy of the discovered endpoints, used to serve requests
+ * right after a restart while discovery runs in the background.
+ *
+ * File layout, all fields in host byte order:
+ *  Header
+ *  ServiceRecord[serviceCount]
+ *  EndpointRecord[endpointCount]
+ *  char stringTable[stringTableSize] (NUL terminated strings)
+ * Header carries a hash of everything following it. Each service carries the
+ * unique name of the mctpd instance the endpoints were read from, so that
+ * endpoints of a restarted mctpd can be dropped on load.
+ */
+struct EndpointSnapshot
+{
+    struct ServiceInfo
+    {
+        std::string uniqueName;
+        std::optional<NetworkID> networkID;
+    };
+
+    MCTPWrapper::EndpointMapExtended endpoints;
+    /* Well known service name to its details */
+    std::unordered_map<std::string, ServiceInfo> services;
+    uint64_t contentHash = 0;
+
+    /**
+     * @brief Load a snapshot written for the same configuration
+     *
+     * @param path Snapshot file path
+     * @param config Configuration of the caller. Snapshots written for a
+     * different message type, binding or vendor filter are rejected
+     * @return std::nullopt if file is missing, corrupted or not matching
+     */
+    static std::optional<EndpointSnapshot>
+        load(const std::string& path, const MCTPConfiguration& config);
+
+    /**
+     * @brief Write snapshot atomically to path
+     *
+     * @return true on success
+     */
+    bool save(const std::string& path, const MCTPConfiguration& config);
+};
+} // namespace internal
+} // namespace mctpw
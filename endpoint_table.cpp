@@ -0,0 +1,198 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "endpoint_table.hpp"
+
+namespace mctpw
+{
+namespace internal
+{
+namespace
+{
+constexpr uint32_t maxDeviceId = 0xFFFF;
+} // namespace
+
+const EndpointTable::Entry* EndpointTable::find(DeviceID deviceId) const
+{
+    if (deviceId.id > maxDeviceId)
+    {
+        return nullptr;
+    }
+    const auto& network = networks[deviceId.networkId()];
+    if (!network)
+    {
+        return nullptr;
+    }
+    const Entry& entry = (*network)[deviceId.mctpEID()];
+    return entry.valid ? &entry : nullptr;
+}
+
+EndpointTable::Entry* EndpointTable::slot(DeviceID deviceId, bool allocate)
+{
+    if (deviceId.id > maxDeviceId)
+    {
+        return nullptr;
+    }
+    auto& network = networks[deviceId.networkId()];
+    if (!network)
+    {
+        if (!allocate)
+        {
+            return nullptr;
+        }
+        network = std::make_unique<Network>();
+    }
+    return &(*network)[deviceId.mctpEID()];
+}
+
+uint16_t EndpointTable::acquireService(const std::string& service)
+{
+    auto it = serviceIds.find(service);
+    if (it != serviceIds.end())
+    {
+        services[it->second].refCount++;
+        return it->second;
+    }
+    uint16_t serviceId;
+    if (!freeServiceIds.empty())
+    {
+        serviceId = freeServiceIds.back();
+        freeServiceIds.pop_back();
+    }
+    else
+    {
+        serviceId = static_cast<uint16_t>(services.size());
+        services.emplace_back();
+    }
+    services[serviceId].name = service;
+    services[serviceId].refCount = 1;
+    serviceIds.emplace(service, serviceId);
+    return serviceId;
+}
+
+void EndpointTable::releaseService(uint16_t serviceId)
+{
+    auto& service = services[serviceId];
+    if (--service.refCount == 0)
+    {
+        serviceIds.erase(service.name);
+        service.name.clear();
+        freeServiceIds.emplace_back(serviceId);
+    }
+}
+
+bool EndpointTable::insert(DeviceID deviceId, unsigned bus,
+                           const std::string& service)
+{
+    Entry* entry = slot(deviceId, true);
+    if (!entry || entry->valid)
+    {
+        return false;
+    }
+    entry->bus = bus;
+    entry->serviceId = acquireService(service);
+    entry->valid = true;
+    count++;
+    generation++;
+    return true;
+}
+
+void EndpointTable::insert_or_assign(DeviceID deviceId, unsigned bus,
+                                     const std::string& service)
+{
+    Entry* entry = slot(deviceId, true);
+    if (!entry)
+    {
+        return;
+    }
+    uint16_t serviceId = acquireService(service);
+    if (entry->valid)
+    {
+        releaseService(entry->serviceId);
+    }
+    else
+    {
+        count++;
+    }
+    entry->bus = bus;
+    entry->serviceId = serviceId;
+    entry->valid = true;
+    generation++;
+}
+
+size_t EndpointTable::erase(DeviceID deviceId)
+{
+    Entry* entry = slot(deviceId, false);
+    if (!entry || !entry->valid)
+    {
+        return 0;
+    }
+    releaseService(entry->serviceId);
+    *entry = Entry{};
+    count--;
+    generation++;
+    return 1;
+}
+
+void EndpointTable::assign(const MCTPWrapper::EndpointMapExtended& endpointMap)
+{
+    for (auto& network : networks)
+    {
+        network.reset();
+    }
+    services.clear();
+    freeServiceIds.clear();
+    serviceIds.clear();
+    count = 0;
+    for (const auto& [deviceId, service] : endpointMap)
+    {
+        insert(deviceId, service.first, service.second);
+    }
+    generation++;
+}
+
+const MCTPWrapper::EndpointMapExtended& EndpointTable::view() const
+{
+    if (viewGeneration == generation)
+    {
+        return cachedView;
+    }
+    cachedView.clear();
+    cachedView.reserve(count);
+    for (size_t networkId = 0; networkId < networkCount; networkId++)
+    {
+        const auto& network = networks[networkId];
+        if (!network)
+        {
+            continue;
+        }
+        for (size_t eid = 0; eid < eidCount; eid++)
+        {
+            const Entry& entry = (*network)[eid];
+            if (entry.valid)
+            {
+                cachedView.emplace(
+                    DeviceID(static_cast<LocalEID>(eid),
+                             static_cast<NetworkID>(networkId)),
+                    std::make_pair(entry.bus, serviceName(entry)));
+            }
+        }
+    }
+    viewGeneration = generation;
+    return cachedView;
+}
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,116 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "mctp_wrapper.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mctpw
+{
+namespace internal
+{
+/**
+ * @brief Endpoint table indexed directly by DeviceID.
+ *
+ * DeviceID carries 8 bit network id and 8 bit eid. Entries are kept in a
+ * two level array: one block of 256 entries is allocated per network id in
+ * use, so lookup is two array indexing operations. Service names are
+ * interned and each entry stores only a small service id.
+ */
+class EndpointTable
+{
+  public:
+    struct Entry
+    {
+        unsigned bus = 0;
+        uint16_t serviceId = 0;
+        bool valid = false;
+    };
+
+    /**
+     * @brief Find entry of a DeviceID
+     *
+     * @return Pointer to entry or nullptr if DeviceID is not in the table.
+     * Pointer is valid until the table is modified
+     */
+    const Entry* find(DeviceID deviceId) const;
+    bool contains(DeviceID deviceId) const
+    {
+        return find(deviceId) != nullptr;
+    }
+    const std::string& serviceName(const Entry& entry) const
+    {
+        return services[entry.serviceId].name;
+    }
+
+    /**
+     * @brief Add an entry if DeviceID is not in the table already
+     *
+     * @return true if entry was added
+     */
+    bool insert(DeviceID deviceId, unsigned bus, const std::string& service);
+    void insert_or_assign(DeviceID deviceId, unsigned bus,
+                          const std::string& service);
+    size_t erase(DeviceID deviceId);
+    /* Replace all entries with content of endpointMap */
+    void assign(const MCTPWrapper::EndpointMapExtended& endpointMap);
+    size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * @brief Map view of the table for APIs returning EndpointMapExtended.
+     * Built on first access after a modification. Contents of a returned
+     * reference are refreshed only by the next call
+     */
+    const MCTPWrapper::EndpointMapExtended& view() const;
+
+  private:
+    static constexpr size_t eidCount = 256;
+    static constexpr size_t networkCount = 256;
+    using Network = std::array<Entry, eidCount>;
+
+    struct Service
+    {
+        std::string name;
+        size_t refCount = 0;
+    };
+
+    std::array<std::unique_ptr<Network>, networkCount> networks{};
+    std::vector<Service> services;
+    std::vector<uint16_t> freeServiceIds;
+    std::unordered_map<std::string, uint16_t> serviceIds;
+    size_t count = 0;
+
+    /* Bumped on every modification */
+    uint64_t generation = 0;
+
+    mutable MCTPWrapper::EndpointMapExtended cachedView;
+    mutable uint64_t viewGeneration = 0;
+
+    Entry* slot(DeviceID deviceId, bool allocate);
+    uint16_t acquireService(const std::string& service);
+    void releaseService(uint16_t serviceId);
+};
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,124 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "flap_detector.hpp"
+
+namespace mctpw
+{
+namespace internal
+{
+FlapDetector::FlapDetector(const MCTPConfiguration& config) :
+    threshold(config.flapThreshold), window(config.flapWindow),
+    holdDown(config.flapHoldDown)
+{
+}
+
+FlapDetector::Verdict FlapDetector::onEvent(const Event& event)
+{
+    if (!enabled())
+    {
+        return Verdict::report;
+    }
+    auto now = std::chrono::steady_clock::now();
+    prune(now);
+    Endpoint& endpoint = endpoints[event.deviceId];
+    endpoint.latest = event;
+    endpoint.stats.transitions++;
+    while (!endpoint.transitions.empty() &&
+           now - endpoint.transitions.front() > window)
+    {
+        endpoint.transitions.pop_front();
+    }
+    endpoint.transitions.emplace_back(now);
+
+    if (endpoint.quarantined)
+    {
+        endpoint.stats.suppressedEvents++;
+        return Verdict::suppress;
+    }
+    if (endpoint.transitions.size() >= threshold)
+    {
+        endpoint.quarantined = true;
+        endpoint.stats.quarantined = true;
+        endpoint.stats.quarantines++;
+        endpoint.stats.suppressedEvents++;
+        return Verdict::quarantine;
+    }
+    endpoint.reported = event;
+    return Verdict::report;
+}
+
+std::vector<Event> FlapDetector::release()
+{
+    std::vector<Event> events;
+    auto now = std::chrono::steady_clock::now();
+    prune(now);
+    for (auto& [deviceId, endpoint] : endpoints)
+    {
+        if (!endpoint.quarantined ||
+            now - endpoint.transitions.back() < holdDown)
+        {
+            continue;
+        }
+        endpoint.quarantined = false;
+        endpoint.stats.quarantined = false;
+        endpoint.transitions.clear();
+        if (!endpoint.reported ||
+            endpoint.reported->type != endpoint.latest->type)
+        {
+            endpoint.reported = endpoint.latest;
+            events.emplace_back(*endpoint.latest);
+        }
+    }
+    return events;
+}
+
+std::optional<std::chrono::steady_clock::time_point>
+    FlapDetector::nextRelease() const
+{
+    std::optional<std::chrono::steady_clock::time_point> next;
+    for (const auto& [deviceId, endpoint] : endpoints)
+    {
+        if (!endpoint.quarantined)
+        {
+            continue;
+        }
+        auto at = endpoint.transitions.back() + holdDown;
+        if (!next || at < *next)
+        {
+            next = at;
+        }
+    }
+    return next;
+}
+
+void FlapDetector::prune(std::chrono::steady_clock::time_point now)
+{
+    std::erase_if(endpoints, [this, now](const auto& entry) {
+        const Endpoint& endpoint = entry.second;
+        return !endpoint.quarantined &&
+               (endpoint.transitions.empty() ||
+                now - endpoint.transitions.back() > window);
+    });
+}
+
+FlapStatistics FlapDetector::statistics(DeviceID devID) const
+{
+    auto it = endpoints.find(devID);
+    return it == endpoints.end() ? FlapStatistics{} : it->second.stats;
+}
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,82 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "mctp_wrapper.hpp"
+
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace mctpw
+{
+namespace internal
+{
+/**
+ * @brief Add/remove flap detection per DeviceID.
+ *
+ * An endpoint with threshold add or remove events within window is
+ * quarantined. Its events are suppressed until it stayed unchanged for
+ * holdDown. Then its latest state is reported once, if it differs from the
+ * state reported last. Endpoints not quarantined and without events within
+ * window are forgotten.
+ */
+class FlapDetector
+{
+  public:
+    enum class Verdict
+    {
+        report,
+        suppress,
+        // Suppressed. This event started the quarantine
+        quarantine
+    };
+
+    explicit FlapDetector(const MCTPConfiguration& config);
+
+    bool enabled() const
+    {
+        return threshold > 0;
+    }
+    Verdict onEvent(const Event& event);
+    /* End quarantines whose hold down elapsed. Returns events to report */
+    std::vector<Event> release();
+    /* Time when the next quarantine can end */
+    std::optional<std::chrono::steady_clock::time_point> nextRelease() const;
+    FlapStatistics statistics(DeviceID devID) const;
+
+  private:
+    struct Endpoint
+    {
+        std::deque<std::chrono::steady_clock::time_point> transitions;
+        std::optional<Event> reported;
+        std::optional<Event> latest;
+        bool quarantined = false;
+        FlapStatistics stats;
+    };
+
+    unsigned threshold;
+    std::chrono::milliseconds window;
+    std::chrono::milliseconds holdDown;
+    std::unordered_map<DeviceID, Endpoint> endpoints;
+
+    /* Drop endpoints which are not quarantined and went quiet for window */
+    void prune(std::chrono::steady_clock::time_point now);
+};
+} // namespace internal
+} // namespace mctpw
@@ -16,21 +16,24 @@
 
 #include "mctp_impl.hpp"
 
+#include "endpoint_snapshot.hpp"
+
 #include <boost/algorithm/string.hpp>
 #include <boost/container/flat_map.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <limits>
 #include <phosphor-logging/log.hpp>
 #include <sdbusplus/asio/connection.hpp>
 #include <sdbusplus/bus/match.hpp>
+#include <sdbusplus/exception.hpp>
+#include <systemd/sd-bus.h>
 #include <unordered_set>
 
-template <typename T1, typename T2>
-using DictType = boost::container::flat_map<T1, T2>;
-using MctpPropertiesVariantType =
-    std::variant<uint16_t, int16_t, int32_t, uint32_t, bool, std::string,
-                 uint8_t, std::vector<uint8_t>>;
-
-// Note: This is a blocking method call. Implement your own yield variants
-// if nonblocking method is needed
+// Note: This is a blocking method call. Use the yield variant below unless
+// the caller has no yield_context to offer
 template <typename Property>
 static Property
     readPropertyValue(sdbusplus::bus::bus& bus, const std::string& service,
@@ -52,14 +55,56 @@ static Property
     return std::get<Property>(v);
 }
 
+template <typename Property>
+static std::optional<Property> getProperty(const mctpw::PropertyMap& properties,
+                                           const std::string& name)
+{
+    auto it = properties.find(name);
+    if (it == properties.end())
+    {
+        return std::nullopt;
+    }
+    if (auto value = std::get_if<Property>(&it->second))
+    {
+        return *value;
+    }
+    return std::nullopt;
+}
+
+template <typename Property>
+static Property readPropertyValue(boost::asio::yield_context yield,
+                                  sdbusplus::asio::connection& connection,
+                                  const std::string& service,
+                                  const std::string& path,
+                                  const std::string& interface,
+                                  const std::string& property)
+{
+    phosphor::logging::log<phosphor::logging::level::DEBUG>(
+        (std::string("Reading ") + service + " " + path + " " + interface +
+         " " + property)
+            .c_str());
+    boost::system::error_code ec;
+    auto v = connection.yield_method_call<std::variant<Property>>(
+        yield, ec, service, path, "org.freedesktop.DBus.Properties", "Get",
+        interface, property);
+    if (ec)
+    {
+        throw boost::system::system_error(
+            ec, "Error reading " + property + " from " + service);
+    }
+    return std::get<Property>(v);
+}
+
 namespace mctpw
 {
-void MCTPImpl::detectMctpEndpointsAsync(StatusCallback&& registerCB)
+void MCTPImpl::detectMctpEndpointsAsync(StatusCallback&& registerCB,
+                                        DiscoveryBatchCallback batchCB)
 {
     boost::asio::spawn(connection->get_io_context(),
                        [registerCB = std::move(registerCB),
+                        batchCB = std::move(batchCB),
                         this](boost::asio::yield_context yield) {
-                           auto ec = detectMctpEndpoints(yield);
+                           auto ec = detectMctpEndpoints(yield, batchCB);
                            if (registerCB)
                            {
                                registerCB(ec, this);
@@ -69,8 +114,8 @@ void MCTPImpl::detectMctpEndpointsAsync(StatusCallback&& registerCB)
 
 void MCTPImpl::triggerMCTPDeviceDiscovery(const DeviceID devID)
 {
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
         phosphor::logging::log<phosphor::logging::level::DEBUG>(
             "triggerMCTPDeviceDiscovery: EID not found in end point map",
@@ -86,15 +131,15 @@ void MCTPImpl::triggerMCTPDeviceDiscovery(const DeviceID devID)
                     ("MCTP device discovery error: " + ec.message()).c_str());
             }
         },
-        it->second.second, "/xyz/openbmc_project/mctp",
+        endpointTable.serviceName(*entry), "/xyz/openbmc_project/mctp",
         "xyz.openbmc_project.MCTP.Base", "TriggerDeviceDiscovery");
 }
 
 int MCTPImpl::reserveBandwidth(boost::asio::yield_context yield,
                                const DeviceID devID, const uint16_t timeout)
 {
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
         phosphor::logging::log<phosphor::logging::level::ERR>(
             ("reserveBandwidth: EID not found in end point map" +
@@ -104,7 +149,7 @@ int MCTPImpl::reserveBandwidth(boost::asio::yield_context yield,
     }
     boost::system::error_code ec;
     int status = connection->yield_method_call<int>(
-        yield, ec, it->second.second, "/xyz/openbmc_project/mctp",
+        yield, ec, endpointTable.serviceName(*entry), "/xyz/openbmc_project/mctp",
         "xyz.openbmc_project.MCTP.Base", "ReserveBandwidth", devID.mctpEID(),
         timeout);
 
@@ -123,14 +168,19 @@ int MCTPImpl::reserveBandwidth(boost::asio::yield_context yield,
              " rc: " + std::to_string(status))
                 .c_str());
     }
+    else
+    {
+        // Reserved endpoint does not share the service request limit
+        scheduler.setServiceLimitBypass(devID, true);
+    }
     return status;
 }
 
 int MCTPImpl::releaseBandwidth(boost::asio::yield_context yield,
                                const DeviceID devID)
 {
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
         phosphor::logging::log<phosphor::logging::level::ERR>(
             ("ReleaseBandwidth: EID not found in end point map" +
@@ -138,9 +188,10 @@ int MCTPImpl::releaseBandwidth(boost::asio::yield_context yield,
                 .c_str());
         return -1;
     }
+    scheduler.setServiceLimitBypass(devID, false);
     boost::system::error_code ec;
     int status = connection->yield_method_call<int>(
-        yield, ec, it->second.second, "/xyz/openbmc_project/mctp",
+        yield, ec, endpointTable.serviceName(*entry), "/xyz/openbmc_project/mctp",
         "xyz.openbmc_project.MCTP.Base", "ReleaseBandwidth", devID.mctpEID());
     if (ec)
     {
@@ -162,7 +213,8 @@ int MCTPImpl::releaseBandwidth(boost::asio::yield_context yield,
 }
 
 boost::system::error_code
-    MCTPImpl::detectMctpEndpoints(boost::asio::yield_context yield)
+    MCTPImpl::detectMctpEndpoints(boost::asio::yield_context yield,
+                                  DiscoveryBatchCallback batchCB)
 {
     phosphor::logging::log<phosphor::logging::level::DEBUG>(
         "Detecting mctp endpoints");
@@ -171,11 +223,49 @@ boost::system::error_code
 
     boost::system::error_code ec =
         boost::system::errc::make_error_code(boost::system::errc::success);
-    auto bus_vector = findBusByBindingType(yield);
-    this->isInitialisationsDone = true;
-    if (bus_vector)
+    if (!config.snapshotPath.empty() && loadEndpointSnapshot(yield))
+    {
+        this->isInitialisationsDone = true;
+        if (batchCB)
+        {
+            batchCB(this, endpointTable.view());
+        }
+        replayPreDiscoveryEvents();
+        // Snapshot may be outdated. Verify it without holding back the caller
+        boost::asio::spawn(
+            connection->get_io_context(),
+            [this](boost::asio::yield_context reconcileYield) {
+                reconcileEndpointMap(reconcileYield);
+            });
+    }
+    else
     {
-        endpointMap = buildMatchingEndpointMap(yield, bus_vector.value());
+        auto bus_vector = findBusByBindingType(yield);
+        if (bus_vector)
+        {
+            std::function<void(const EndpointMapExtended&)> onServiceScanned;
+            if (batchCB)
+            {
+                // Make endpoints of each service usable as soon as it is
+                // scanned. The complete map replaces them at the end
+                onServiceScanned = [this,
+                                    &batchCB](const EndpointMapExtended& batch) {
+                    for (const auto& [deviceId, service] : batch)
+                    {
+                        endpointTable.insert_or_assign(deviceId, service.first,
+                                                    service.second);
+                    }
+                    batchCB(this, batch);
+                };
+            }
+            endpointTable.assign(buildMatchingEndpointMap(
+                yield, bus_vector.value(), onServiceScanned));
+            pruneResolvedEndpoints();
+        }
+        // Signals received until now were buffered. Map is complete only now
+        this->isInitialisationsDone = true;
+        replayPreDiscoveryEvents();
+        saveEndpointSnapshot();
     }
 
     if (responderVersions.size() > 0)
@@ -193,26 +283,179 @@ boost::system::error_code
 
     phosphor::logging::log<phosphor::logging::level::DEBUG>(
         ("Detecting mctp endpoints completed. Found " +
-         std::to_string(endpointMap.size()))
+         std::to_string(endpointTable.size()))
             .c_str());
     return ec;
 }
 
-int MCTPImpl::getBusId(const std::string& serviceName)
+bool MCTPImpl::loadEndpointSnapshot(boost::asio::yield_context yield)
+{
+    auto snapshot =
+        internal::EndpointSnapshot::load(config.snapshotPath, config);
+    if (!snapshot)
+    {
+        return false;
+    }
+
+    // Endpoints are valid only if the same mctpd instance is still running.
+    // A restarted mctpd will have a different unique name
+    std::vector<std::string> serviceNames;
+    for (const auto& [name, info] : snapshot->services)
+    {
+        serviceNames.emplace_back(name);
+    }
+    std::vector<std::optional<std::string>> owners(serviceNames.size());
+    runConcurrently(
+        yield, serviceNames.size(), config.discoveryFanOut,
+        [this, &serviceNames, &owners](size_t index,
+                                       boost::asio::yield_context workerYield) {
+            boost::system::error_code ec;
+            auto owner = connection->yield_method_call<std::string>(
+                workerYield, ec, "org.freedesktop.DBus",
+                "/org/freedesktop/DBus", "org.freedesktop.DBus",
+                "GetNameOwner", serviceNames[index]);
+            if (!ec)
+            {
+                owners[index] = std::move(owner);
+            }
+        });
+
+    std::unordered_set<std::string> validServices;
+    for (size_t index = 0; index < serviceNames.size(); index++)
+    {
+        const auto& name = serviceNames[index];
+        const auto& info = snapshot->services.at(name);
+        if (!owners[index] || *owners[index] != info.uniqueName)
+        {
+            phosphor::logging::log<phosphor::logging::level::INFO>(
+                ("Snapshot entries of " + name + " are outdated").c_str());
+            continue;
+        }
+        validServices.emplace(name);
+        this->uniqueNames[name] = info.uniqueName;
+        this->wellKnownNames.emplace(name);
+        this->matchedBuses.emplace(info.uniqueName);
+        registerListeners(info.uniqueName);
+        if (info.networkID)
+        {
+            this->networkIDCache.insert_or_assign(name, *info.networkID);
+            this->networkIDCache.insert_or_assign(info.uniqueName,
+                                                  *info.networkID);
+        }
+    }
+    if (validServices.empty())
+    {
+        return false;
+    }
+
+    for (const auto& [deviceId, service] : snapshot->endpoints)
+    {
+        if (validServices.contains(service.second))
+        {
+            this->endpointTable.insert_or_assign(deviceId, service.first,
+                                                     service.second);
+        }
+    }
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        ("Serving " + std::to_string(endpointTable.size()) +
+         " endpoints from snapshot " + config.snapshotPath)
+            .c_str());
+    return true;
+}
+
+void MCTPImpl::saveEndpointSnapshot()
+{
+    if (config.snapshotPath.empty())
+    {
+        return;
+    }
+    internal::EndpointSnapshot snapshot;
+    snapshot.endpoints = this->endpointTable.view();
+    for (const auto& [name, uniqueName] : this->uniqueNames)
+    {
+        internal::EndpointSnapshot::ServiceInfo info;
+        info.uniqueName = uniqueName;
+        info.networkID = getCachedNetworkID(name);
+        snapshot.services.emplace(name, std::move(info));
+    }
+    snapshot.save(config.snapshotPath, config);
+}
+
+void MCTPImpl::reconcileEndpointMap(boost::asio::yield_context yield)
+{
+    auto bus_vector = findBusByBindingType(yield);
+    if (!bus_vector)
+    {
+        return;
+    }
+    auto freshMap = buildMatchingEndpointMap(yield, bus_vector.value());
+
+    std::vector<DeviceID> removed;
+    std::vector<DeviceID> added;
+    for (const auto& [deviceId, service] : this->endpointTable.view())
+    {
+        if (!freshMap.contains(deviceId))
+        {
+            removed.emplace_back(deviceId);
+        }
+    }
+    for (const auto& [deviceId, service] : freshMap)
+    {
+        if (!this->endpointTable.contains(deviceId))
+        {
+            added.emplace_back(deviceId);
+        }
+    }
+    this->endpointTable.assign(freshMap);
+    pruneResolvedEndpoints();
+
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        ("Snapshot verified. Added " + std::to_string(added.size()) +
+         " removed " + std::to_string(removed.size()) + " endpoints")
+            .c_str());
+    for (auto deviceId : removed)
+    {
+        emitNetworkChangeEvent(Event::EventType::deviceRemoved, deviceId);
+    }
+    for (auto deviceId : added)
+    {
+        emitNetworkChangeEvent(Event::EventType::deviceAdded, deviceId);
+    }
+    saveEndpointSnapshot();
+}
+
+int MCTPImpl::getBusId(boost::asio::yield_context yield,
+                       const std::string& serviceName)
 {
     // TODO - the bus ID parameter is unused in the library, this can be cleaned
     // up
     try
     {
         int bus = -1;
-        static int i3cBusId = 0;
         if (config.bindingType == mctpw::BindingType::mctpOverSmBus)
         {
-            std::string pv = readPropertyValue<std::string>(
-                static_cast<sdbusplus::bus::bus&>(*connection), serviceName,
-                "/xyz/openbmc_project/mctp",
-                mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType),
-                "BusPath");
+            const PropertyMap* properties = getServiceProperties(
+                yield, serviceName,
+                mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType));
+            std::string pv;
+            if (properties)
+            {
+                auto busPath = getProperty<std::string>(*properties, "BusPath");
+                if (!busPath)
+                {
+                    throw std::runtime_error("BusPath property not found");
+                }
+                pv = *busPath;
+            }
+            else
+            {
+                pv = readPropertyValue<std::string>(
+                    yield, *connection, serviceName,
+                    "/xyz/openbmc_project/mctp",
+                    mctpw::MCTPWrapper::bindingToInterface.at(
+                        config.bindingType),
+                    "BusPath");
+            }
             // sample buspath like /dev/i2c-2
             /* format of BusPath:path-bus */
             std::vector<std::string> splitted;
@@ -232,15 +475,31 @@ int MCTPImpl::getBusId(const std::string& serviceName)
         }
         else if (config.bindingType == mctpw::BindingType::mctpOverPcieVdm)
         {
-            bus = readPropertyValue<uint16_t>(
-                static_cast<sdbusplus::bus::bus&>(*connection), serviceName,
-                "/xyz/openbmc_project/mctp",
-                mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType),
-                "BDF");
+            const PropertyMap* properties = getServiceProperties(
+                yield, serviceName,
+                mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType));
+            if (properties)
+            {
+                auto bdf = getProperty<uint16_t>(*properties, "BDF");
+                if (!bdf)
+                {
+                    throw std::runtime_error("BDF property not found");
+                }
+                bus = *bdf;
+            }
+            else
+            {
+                bus = readPropertyValue<uint16_t>(
+                    yield, *connection, serviceName,
+                    "/xyz/openbmc_project/mctp",
+                    mctpw::MCTPWrapper::bindingToInterface.at(
+                        config.bindingType),
+                    "BDF");
+            }
         }
         else if (config.bindingType == mctpw::BindingType::mctpOverI3C)
         {
-            bus = i3cBusId++;
+            bus = getI3CBusId(serviceName);
         }
         else
         {
@@ -273,8 +532,110 @@ void MCTPImpl::addUniqueNameToMatchedServices(const std::string& serviceName,
             errMsg.c_str());
         uniqueName = serviceName;
     }
+    else
+    {
+        this->uniqueNames[serviceName] = uniqueName;
+        this->wellKnownNames.emplace(serviceName);
+    }
 
     this->matchedBuses.emplace(uniqueName);
+    registerListeners(uniqueName);
+}
+
+const PropertyMap*
+    MCTPImpl::getCachedServiceProperties(const std::string& serviceName,
+                                         const std::string& interface) const
+{
+    auto it = this->servicePropertiesCache.find(serviceName);
+    if (it == this->servicePropertiesCache.end())
+    {
+        return nullptr;
+    }
+    auto intf = it->second.find(interface);
+    if (intf == it->second.end())
+    {
+        return nullptr;
+    }
+    return &intf->second;
+}
+
+const PropertyMap*
+    MCTPImpl::getServiceProperties(boost::asio::yield_context yield,
+                                   const std::string& serviceName,
+                                   const std::string& interface)
+{
+    if (auto properties = getCachedServiceProperties(serviceName, interface))
+    {
+        return properties;
+    }
+
+    boost::system::error_code ec;
+    auto properties = connection->yield_method_call<PropertyMap>(
+        yield, ec, serviceName, "/xyz/openbmc_project/mctp",
+        "org.freedesktop.DBus.Properties", "GetAll", interface);
+    if (ec)
+    {
+        phosphor::logging::log<phosphor::logging::level::WARNING>(
+            ("GetAll " + interface + " failed on " + serviceName + ". " +
+             ec.message() + ". Properties will be read one by one")
+                .c_str());
+        return nullptr;
+    }
+
+    auto [it, inserted] =
+        this->servicePropertiesCache[serviceName].insert_or_assign(
+            interface, std::move(properties));
+    return &it->second;
+}
+
+void MCTPImpl::updateServiceProperties(const std::string& sender,
+                                       const std::string& interface,
+                                       const PropertyMap& changedProperties)
+{
+    auto update = [this, &interface,
+                   &changedProperties](const std::string& name) {
+        auto it = this->servicePropertiesCache.find(name);
+        if (it != this->servicePropertiesCache.end())
+        {
+            auto intf = it->second.find(interface);
+            if (intf != it->second.end())
+            {
+                for (const auto& [property, value] : changedProperties)
+                {
+                    intf->second.insert_or_assign(property, value);
+                }
+            }
+        }
+        auto networkID =
+            getProperty<NetworkID>(changedProperties, "NetworkID");
+        if (networkID && interface == "xyz.openbmc_project.MCTP.Base")
+        {
+            this->networkIDCache.insert_or_assign(name, *networkID);
+        }
+    };
+
+    // Signals carry unique name of the sender. Cache may be keyed using the
+    // well known name as well
+    update(sender);
+    for (const auto& [wellKnownName, uniqueName] : this->uniqueNames)
+    {
+        if (uniqueName == sender)
+        {
+            update(wellKnownName);
+        }
+    }
+}
+
+void MCTPImpl::eraseServiceProperties(const std::string& sender)
+{
+    this->servicePropertiesCache.erase(sender);
+    for (const auto& [wellKnownName, uniqueName] : this->uniqueNames)
+    {
+        if (uniqueName == sender)
+        {
+            this->servicePropertiesCache.erase(wellKnownName);
+        }
+    }
 }
 
 std::optional<std::vector<std::pair<unsigned, std::string>>>
@@ -303,18 +664,42 @@ std::optional<std::vector<std::pair<unsigned, std::string>>>
                     .c_str());
         }
 
+        std::vector<std::string> serviceNames;
         for (const auto& [service, intfs] : services)
         {
-            try
+            serviceNames.emplace_back(service);
+        }
+        if (config.bindingType == mctpw::BindingType::mctpOverI3C)
+        {
+            // Number services in the order GetObject returned them, not in
+            // the order the concurrent lookups below finish
+            for (const auto& service : serviceNames)
             {
-                int bus = this->getBusId(service);
-                buses.emplace_back(bus, service);
-                addUniqueNameToMatchedServices(service, yield);
+                getI3CBusId(service);
             }
-            catch (const std::exception& e)
+        }
+        std::vector<std::optional<int>> busIds(serviceNames.size());
+        runConcurrently(
+            yield, serviceNames.size(), config.discoveryFanOut,
+            [this, &serviceNames, &busIds](
+                size_t index, boost::asio::yield_context workerYield) {
+                const auto& service = serviceNames[index];
+                try
+                {
+                    busIds[index] = this->getBusId(workerYield, service);
+                    addUniqueNameToMatchedServices(service, workerYield);
+                }
+                catch (const std::exception& e)
+                {
+                    phosphor::logging::log<phosphor::logging::level::WARNING>(
+                        e.what());
+                }
+            });
+        for (size_t index = 0; index < serviceNames.size(); index++)
+        {
+            if (busIds[index])
             {
-                phosphor::logging::log<phosphor::logging::level::WARNING>(
-                    e.what());
+                buses.emplace_back(*busIds[index], serviceNames[index]);
             }
         }
         // buses will contain list of {busid servicename}. Sample busid may
@@ -329,141 +714,235 @@ std::optional<std::vector<std::pair<unsigned, std::string>>>
     }
 }
 
+void MCTPImpl::runConcurrently(
+    boost::asio::yield_context yield, size_t count, size_t limit,
+    const std::function<void(size_t, boost::asio::yield_context)>& task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    struct State
+    {
+        State(boost::asio::io_context& ioc) : done(ioc)
+        {
+        }
+        size_t next = 0;
+        size_t active = 0;
+        boost::asio::steady_timer done;
+    };
+    auto state = std::make_shared<State>(connection->get_io_context());
+    state->done.expires_at(boost::asio::steady_timer::time_point::max());
+    const size_t workers = (limit == 0) ? count : std::min(count, limit);
+    state->active = workers;
+
+    for (size_t i = 0; i < workers; i++)
+    {
+        boost::asio::spawn(
+            connection->get_io_context(),
+            [state, count, &task](boost::asio::yield_context workerYield) {
+                while (state->next < count)
+                {
+                    size_t index = state->next++;
+                    try
+                    {
+                        task(index, workerYield);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        phosphor::logging::log<phosphor::logging::level::ERR>(
+                            (std::string("runConcurrently: ") + e.what())
+                                .c_str());
+                    }
+                }
+                if (--state->active == 0)
+                {
+                    state->done.cancel();
+                }
+            });
+    }
+
+    // spawn runs a worker inline until its first yield. Workers which never
+    // yield may all be done already
+    if (state->active == 0)
+    {
+        return;
+    }
+    boost::system::error_code ec;
+    state->done.async_wait(yield[ec]);
+}
+
+bool MCTPImpl::isMatchingEndpoint(
+    const sdbusplus::message::object_path& objectPath,
+    const InterfaceMap& interfaces) const
+{
+    /*SupportedMessageTypes interface is mandatory*/
+    auto& msgIf =
+        interfaces.at("xyz.openbmc_project.MCTP.SupportedMessageTypes");
+    auto pv = msgIf.at(msgTypeToPropertyName.at(config.type));
+
+    if (std::get<bool>(pv) == false)
+    {
+        return false;
+    }
+    if (mctpw::MessageType::vdpci != config.type)
+    {
+        return true;
+    }
+    if (!config.vendorId)
+    {
+        if (config.vendorMessageType)
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                "Vendor Message Type matching is not allowed "
+                "when Vendor ID is not set");
+            return false;
+        }
+        return true;
+    }
+
+    auto itVendorIf =
+        interfaces.find("xyz.openbmc_project.MCTP.PCIVendorDefined");
+    if (itVendorIf == interfaces.end())
+    {
+        phosphor::logging::log<phosphor::logging::level::INFO>(
+            ("PCIVendorDefined interface not found for " + objectPath.str)
+                .c_str());
+        return false;
+    }
+    const auto& vendorProperties = itVendorIf->second;
+
+    auto vendorIdStr = getProperty<std::string>(vendorProperties, "VendorID");
+    if (!vendorIdStr || static_cast<uint16_t>(std::stoi(
+                            *vendorIdStr, nullptr, 16)) !=
+                            be16toh(*config.vendorId))
+    {
+        phosphor::logging::log<phosphor::logging::level::INFO>(
+            ("VendorID not matching for " + objectPath.str).c_str());
+        return false;
+    }
+
+    if (config.vendorMessageType)
+    {
+        auto msgTypes = getProperty<std::vector<uint16_t>>(
+            vendorProperties, "MessageTypeProperty");
+        if (!msgTypes ||
+            std::find(msgTypes->begin(), msgTypes->end(),
+                      be16toh(config.vendorMessageType->value)) ==
+                msgTypes->end())
+        {
+            phosphor::logging::log<phosphor::logging::level::INFO>(
+                ("Vendor Message Type not matching for " + objectPath.str)
+                    .c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
 /* Return format:
  * map<Eid, pair<bus, service_name_string>>
  */
 MCTPImpl::EndpointMapExtended MCTPImpl::buildMatchingEndpointMap(
     boost::asio::yield_context yield,
-    std::vector<std::pair<unsigned, std::string>>& buses)
+    std::vector<std::pair<unsigned, std::string>>& buses,
+    const std::function<void(const EndpointMapExtended&)>& onServiceScanned)
 {
+    using ManagedObjectType =
+        DictType<sdbusplus::message::object_path, InterfaceMap>;
     std::unordered_map<DeviceID, std::pair<unsigned, std::string>> eids;
-    for (auto& bus : buses)
-    {
-        boost::system::error_code ec;
-        DictType<sdbusplus::message::object_path,
-                 DictType<std::string,
-                          DictType<std::string, MctpPropertiesVariantType>>>
-            values;
-        // get all objects, interfaces and properties in a single method
-        // call DICT<OBJPATH,DICT<STRING,DICT<STRING,VARIANT>>>
-        // objpath_interfaces_and_properties
-        values = connection->yield_method_call<decltype(values)>(
-            yield, ec, bus.second.c_str(), "/xyz/openbmc_project/mctp",
-            "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
 
-        if (ec)
-        {
-            phosphor::logging::log<phosphor::logging::level::WARNING>(
-                (std::string("Error getting managed objects on ") + bus.second +
-                 ". Bus " + std::to_string(bus.first))
-                    .c_str());
-            continue;
-        }
-        NetworkID nwid = getNetworkID(bus.second);
-        for (const auto& [objectPath, interfaces] : values)
-        {
-            DictType<std::string,
-                     DictType<std::string, MctpPropertiesVariantType>>
-                interface;
+    // GetManagedObjects calls are independent of each other. Send them in
+    // parallel so that discovery time is bound by the slowest service. All
+    // the data needed for filtering is in the reply itself
+    runConcurrently(
+        yield, buses.size(), config.discoveryFanOut,
+        [this, &buses, &eids, &onServiceScanned](
+            size_t index, boost::asio::yield_context workerYield) {
+            const auto& bus = buses[index];
+            boost::system::error_code ec;
+            // get all objects, interfaces and properties in a single method
+            // call DICT<OBJPATH,DICT<STRING,DICT<STRING,VARIANT>>>
+            // objpath_interfaces_and_properties
+            auto values = connection->yield_method_call<ManagedObjectType>(
+                workerYield, ec, bus.second.c_str(),
+                "/xyz/openbmc_project/mctp",
+                "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
 
-            if (interfaces.find("xyz.openbmc_project.MCTP.Endpoint") ==
-                interfaces.end())
+            if (ec)
             {
-                continue;
+                phosphor::logging::log<phosphor::logging::level::WARNING>(
+                    (std::string("Error getting managed objects on ") +
+                     bus.second + ". Bus " + std::to_string(bus.first))
+                        .c_str());
+                return;
             }
-            try
-            {
-                /*SupportedMessageTypes interface is mandatory*/
-                auto& msgIf = interfaces.at(
-                    "xyz.openbmc_project.MCTP.SupportedMessageTypes");
-                MctpPropertiesVariantType pv;
-                pv = msgIf.at(msgTypeToPropertyName.at(config.type));
 
-                if (std::get<bool>(pv) == false)
+            EndpointMapExtended serviceEids;
+            NetworkID nwid = getNetworkID(workerYield, bus.second);
+            for (const auto& [objectPath, interfaces] : values)
+            {
+                if (interfaces.find("xyz.openbmc_project.MCTP.Endpoint") ==
+                    interfaces.end())
                 {
                     continue;
                 }
-                if (mctpw::MessageType::vdpci == config.type)
+                try
                 {
-                    if (config.vendorId)
+                    if (!isMatchingEndpoint(objectPath, interfaces))
                     {
-                        static const char* vdMsgTypeInterface =
-                            "xyz.openbmc_project.MCTP.PCIVendorDefined";
-                        auto vendorIdStr = readPropertyValue<std::string>(
-                            *connection, bus.second.c_str(), objectPath.str,
-                            vdMsgTypeInterface, "VendorID");
-                        uint16_t vendorId = static_cast<uint16_t>(
-                            std::stoi(vendorIdStr, nullptr, 16));
-                        if (vendorId != be16toh(*config.vendorId))
-                        {
-                            phosphor::logging::log<
-                                phosphor::logging::level::INFO>(
-                                ("VendorID not matching for " + objectPath.str)
-                                    .c_str());
-                            continue;
-                        }
-
-                        if (config.vendorMessageType)
-                        {
-                            auto msgTypes =
-                                readPropertyValue<std::vector<uint16_t>>(
-                                    *connection, bus.second.c_str(),
-                                    objectPath.str, vdMsgTypeInterface,
-                                    "MessageTypeProperty");
-                            auto itMsgType = std::find(
-                                msgTypes.begin(), msgTypes.end(),
-                                be16toh(config.vendorMessageType->value));
-                            if (msgTypes.end() == itMsgType)
-                            {
-                                phosphor::logging::log<
-                                    phosphor::logging::level::INFO>(
-                                    ("Vendor Message Type not matching for " +
-                                     objectPath.str)
-                                        .c_str());
-                                continue;
-                            }
-                        }
+                        continue;
                     }
-                    else
+                    /* format of of endpoint path: path/Eid */
+                    std::vector<std::string> splitted;
+                    boost::split(splitted, objectPath.str,
+                                 boost::is_any_of("/"));
+                    if (splitted.size())
                     {
-                        if (config.vendorMessageType)
-                        {
-                            phosphor::logging::log<
-                                phosphor::logging::level::ERR>(
-                                "Vendor Message Type matching is not allowed "
-                                "when Vendor ID is not set");
-                            continue;
-                        }
+                        // TODO: Check nwid and value in object path is same
+                        /* take the last element and convert it to eid */
+                        uint8_t eid = static_cast<eid_t>(
+                            std::stoi(splitted[splitted.size() - 1]));
+                        serviceEids[DeviceID(eid, nwid)] = bus;
                     }
                 }
-                /* format of of endpoint path: path/Eid */
-                std::vector<std::string> splitted;
-                boost::split(splitted, objectPath.str, boost::is_any_of("/"));
-                if (splitted.size())
+                catch (std::exception& e)
                 {
-                    // TODO: Check nwid and value in object path is same
-                    /* take the last element and convert it to eid */
-                    uint8_t eid = static_cast<eid_t>(
-                        std::stoi(splitted[splitted.size() - 1]));
-                    eids[DeviceID(eid, nwid)] = bus;
+                    phosphor::logging::log<phosphor::logging::level::ERR>(
+                        e.what());
                 }
             }
-            catch (std::exception& e)
+
+            for (const auto& [deviceId, service] : serviceEids)
             {
-                phosphor::logging::log<phosphor::logging::level::ERR>(e.what());
+                eids.insert_or_assign(deviceId, service);
             }
-        }
-    }
-    return eids;
-}
+            if (onServiceScanned)
+            {
+                onServiceScanned(serviceEids);
+            }
+        });
+    return eids;
+}
 
 void MCTPImpl::sendReceiveAsync(ReceiveCallback callback, DeviceID devID,
                                 const ByteArray& request,
-                                std::chrono::milliseconds timeout)
+                                std::chrono::milliseconds timeout,
+                                Priority priority, const RetryPolicy* policy)
+{
+    ByteSpan part(request);
+    sendReceiveAsync(std::move(callback), devID, ByteSpanList(&part, 1),
+                     timeout, priority, policy);
+}
+
+void MCTPImpl::sendReceiveAsync(ReceiveCallback callback, DeviceID devID,
+                                ByteSpanList request,
+                                std::chrono::milliseconds timeout,
+                                Priority priority, const RetryPolicy* policy)
 {
     ByteArray response;
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
         phosphor::logging::log<phosphor::logging::level::DEBUG>(
             "SendReceiveAsync: Eid not found in end point map",
@@ -477,37 +956,632 @@ void MCTPImpl::sendReceiveAsync(ReceiveCallback callback, DeviceID devID,
         return;
     }
 
-    connection->async_method_call(
-        callback, it->second.second, "/xyz/openbmc_project/mctp",
-        "xyz.openbmc_project.MCTP.Base", "SendReceiveMctpMessagePayload",
-        devID.mctpEID(), request, static_cast<uint16_t>(timeout.count()));
+    scheduleSendReceive(std::move(callback), endpointTable.serviceName(*entry),
+                        devID, request, timeout, priority,
+                        policy ? *policy : config.retryPolicy);
+}
+
+void MCTPImpl::sendReceiveAsync(ReceiveCallback callback,
+                                const internal::ResolvedEndpoint& endpoint,
+                                const ByteArray& request,
+                                std::chrono::milliseconds timeout,
+                                Priority priority)
+{
+    ByteSpan part(request);
+    scheduleSendReceive(std::move(callback), endpoint.service,
+                        endpoint.deviceId, ByteSpanList(&part, 1), timeout,
+                        priority, config.retryPolicy);
+}
+
+struct MCTPImpl::RetryRequest
+{
+    explicit RetryRequest(boost::asio::io_context& ioc) : timer(ioc)
+    {
+    }
+    RetryPolicy policy;
+    std::string service;
+    DeviceID devID{};
+    ByteArray request;
+    std::chrono::milliseconds timeout{};
+    Priority priority = Priority::normal;
+    ReceiveCallback callback;
+    // Attempts sent, not counting the hedged copy
+    unsigned attempts = 0;
+    unsigned outstanding = 0;
+    bool hedged = false;
+    bool done = false;
+    // Waits for backoff or for the hedging delay
+    boost::asio::steady_timer timer;
+};
+
+void MCTPImpl::scheduleSendReceive(ReceiveCallback callback,
+                                   const std::string& service, DeviceID devID,
+                                   ByteSpanList request,
+                                   std::chrono::milliseconds timeout,
+                                   Priority priority, const RetryPolicy& policy)
+{
+    if (responseCache.enabled())
+    {
+        ByteArray payload;
+        for (const auto& part : request)
+        {
+            payload.insert(payload.end(), part.begin(), part.end());
+        }
+        if (auto key = responseCache.keyOf(devID, payload))
+        {
+            if (auto cached = responseCache.find(*key, payload))
+            {
+                // Complete from the event loop like a response from the bus
+                boost::asio::post(connection->get_io_context(),
+                                  [callback = std::move(callback),
+                                   response = std::move(*cached)]() mutable {
+                                      if (callback)
+                                      {
+                                          boost::system::error_code ec;
+                                          callback(ec, response);
+                                      }
+                                  });
+                return;
+            }
+            callback = [this, key = std::move(*key),
+                        callback = std::move(callback)](
+                           boost::system::error_code ec, ByteArray& response) {
+                if (!ec)
+                {
+                    responseCache.insert(key, response);
+                }
+                if (callback)
+                {
+                    callback(ec, response);
+                }
+            };
+        }
+    }
+
+    if (policy.maxAttempts > 1 || policy.hedge)
+    {
+        auto retry = std::make_shared<RetryRequest>(
+            connection->get_io_context());
+        retry->policy = policy;
+        retry->service = service;
+        retry->devID = devID;
+        for (const auto& part : request)
+        {
+            retry->request.insert(retry->request.end(), part.begin(),
+                                  part.end());
+        }
+        retry->timeout = timeout;
+        retry->priority = priority;
+        retry->callback = std::move(callback);
+        startAttempt(retry, false);
+        return;
+    }
+    submitSendReceive(std::move(callback), service, devID, request, timeout,
+                      priority, true);
+}
+
+void MCTPImpl::submitSendReceive(ReceiveCallback callback,
+                                 const std::string& service, DeviceID devID,
+                                 ByteSpanList request,
+                                 std::chrono::milliseconds timeout,
+                                 Priority priority, bool coalescable,
+                                 std::function<bool()> takeSample)
+{
+    if (coalescable && config.coalesceRequests)
+    {
+        callback = coalesce(std::move(callback), devID, request);
+        if (!callback)
+        {
+            return;
+        }
+    }
+    if (circuitBreakers.enabled())
+    {
+        if (!circuitBreakers.allow(devID))
+        {
+            ByteArray response;
+            if (callback)
+            {
+                callback(boost::system::errc::make_error_code(
+                             boost::system::errc::host_unreachable),
+                         response);
+            }
+            return;
+        }
+        callback = [this, devID, callback = std::move(callback)](
+                       boost::system::error_code ec, ByteArray& response) {
+            if (!ec)
+            {
+                circuitBreakers.onSuccess(devID);
+            }
+            else if (ec == boost::system::errc::no_buffer_space ||
+                     ec == boost::system::errc::invalid_argument ||
+                     ec == boost::system::errc::connection_aborted)
+            {
+                // Local refusals and requests aborted because mctpd went
+                // away say nothing about the device
+                circuitBreakers.onAbandoned(devID);
+            }
+            else
+            {
+                circuitBreakers.onFailure(devID);
+            }
+            if (callback)
+            {
+                callback(ec, response);
+            }
+        };
+    }
+
+    if (config.maxInFlightPerEndpoint == 0 && config.maxInFlightPerService == 0)
+    {
+        // Nothing is ever queued. Skip the scheduler bookkeeping
+        doSendReceiveAsync(std::move(callback), service, devID, request,
+                           timeout, std::move(takeSample));
+        return;
+    }
+
+    auto scheduled = std::make_shared<ScheduledRequest>();
+    scheduled->devID = devID;
+    // Requests through EndpointHandle use the unique name. Keep one service
+    // budget per mctpd
+    scheduled->service = canonicalServiceName(service);
+    scheduled->priority = priority;
+    scheduled->callback = std::move(callback);
+
+    switch (scheduler.submit(scheduled))
+    {
+        case internal::RequestScheduler::Admission::started:
+            doSendReceiveAsync(scheduledCompletion(scheduled), service, devID,
+                               request, timeout, std::move(takeSample));
+            return;
+        case internal::RequestScheduler::Admission::rejected: {
+            phosphor::logging::log<phosphor::logging::level::DEBUG>(
+                "SendReceiveAsync: Request queue is full",
+                phosphor::logging::entry("EID=%d", devID.id));
+            ByteArray response;
+            finishScheduledRequest(scheduled,
+                                   boost::system::errc::make_error_code(
+                                       boost::system::errc::no_buffer_space),
+                                   response);
+            return;
+        }
+        case internal::RequestScheduler::Admission::queued:
+            break;
+    }
+
+    // Spans are valid only during this call. Keep a copy until the request
+    // can be sent
+    ByteArray payload;
+    for (const auto& part : request)
+    {
+        payload.insert(payload.end(), part.begin(), part.end());
+    }
+    scheduled->start = [this, service, devID, timeout,
+                        payload = std::move(payload),
+                        takeSample = std::move(takeSample)](
+                           const std::shared_ptr<ScheduledRequest>& self) {
+        ByteSpan part(payload);
+        doSendReceiveAsync(scheduledCompletion(self), service, devID,
+                           ByteSpanList(&part, 1), timeout, takeSample);
+    };
+}
+
+MCTPImpl::ReceiveCallback MCTPImpl::coalesce(ReceiveCallback callback,
+                                             DeviceID devID,
+                                             ByteSpanList request)
+{
+    ByteArray payload;
+    for (const auto& part : request)
+    {
+        payload.insert(payload.end(), part.begin(), part.end());
+    }
+    // FNV-1a over DeviceID and request bytes
+    size_t key = 14695981039346656037ULL;
+    auto mix = [&key](uint8_t byte) {
+        key ^= byte;
+        key *= 1099511628211ULL;
+    };
+    for (size_t shift = 0; shift < 32; shift += 8)
+    {
+        mix(static_cast<uint8_t>(devID.id >> shift));
+    }
+    for (uint8_t byte : payload)
+    {
+        mix(byte);
+    }
+
+    auto [first, last] = this->coalescedRequests.equal_range(key);
+    for (auto it = first; it != last; ++it)
+    {
+        auto& pending = *it->second;
+        if (pending.devID == devID && pending.request == payload)
+        {
+            pending.callbacks.emplace_back(std::move(callback));
+            return nullptr;
+        }
+    }
+
+    auto pending = std::make_shared<CoalescedRequest>();
+    pending->devID = devID;
+    pending->request = std::move(payload);
+    pending->callbacks.emplace_back(std::move(callback));
+    this->coalescedRequests.emplace(key, pending);
+    return [this, key, pending](boost::system::error_code ec,
+                                ByteArray& response) {
+        // Remove first. Requests made from the callbacks are sent anew
+        auto [first, last] = this->coalescedRequests.equal_range(key);
+        for (auto it = first; it != last; ++it)
+        {
+            if (it->second == pending)
+            {
+                this->coalescedRequests.erase(it);
+                break;
+            }
+        }
+        auto& callbacks = pending->callbacks;
+        for (size_t i = 0; i < callbacks.size(); i++)
+        {
+            if (!callbacks[i])
+            {
+                continue;
+            }
+            if (i + 1 == callbacks.size())
+            {
+                callbacks[i](ec, response);
+            }
+            else
+            {
+                ByteArray copy = response;
+                callbacks[i](ec, copy);
+            }
+        }
+    };
+}
+
+MCTPImpl::ReceiveCallback MCTPImpl::scheduledCompletion(
+    const std::shared_ptr<ScheduledRequest>& scheduled)
+{
+    return [this, scheduled](boost::system::error_code ec,
+                             ByteArray& response) {
+        finishScheduledRequest(scheduled, ec, response);
+    };
+}
+
+void MCTPImpl::finishScheduledRequest(
+    const std::shared_ptr<ScheduledRequest>& scheduled,
+    boost::system::error_code ec, ByteArray& response)
+{
+    // Waiting requests are started before the callback so that a request
+    // made from the callback does not overtake them
+    if (!scheduler.finish(scheduled))
+    {
+        // Already completed early. Late response is dropped
+        return;
+    }
+    if (scheduled->callback)
+    {
+        scheduled->callback(ec, response);
+    }
+}
+
+void MCTPImpl::startAttempt(const std::shared_ptr<RetryRequest>& retry,
+                            bool hedge)
+{
+    if (hedge)
+    {
+        retry->hedged = true;
+    }
+    else
+    {
+        retry->attempts++;
+    }
+    retry->outstanding++;
+    ByteSpan part(retry->request);
+    // Karn's rule. Round trip of a retried or hedged request is ambiguous,
+    // so only the first attempt of a request never hedged is sampled
+    bool firstAttempt = !hedge && retry->attempts == 1;
+    // A hedged copy must not be merged into the attempt it races
+    submitSendReceive(
+        [this, retry](boost::system::error_code ec, ByteArray& response) {
+            retry->outstanding--;
+            onAttemptDone(retry, ec, response);
+        },
+        retry->service, retry->devID, ByteSpanList(&part, 1), retry->timeout,
+        retry->priority, !hedge, [retry, firstAttempt] {
+            return firstAttempt && !retry->hedged;
+        });
+
+    // One hedged copy per request, on top of maxAttempts
+    if (!retry->policy.hedge || hedge || retry->hedged || retry->done)
+    {
+        return;
+    }
+    auto delay = rttEstimator.percentile(retry->devID, 0.95);
+    if (!delay || *delay >= retry->timeout)
+    {
+        return;
+    }
+    retry->timer.expires_after(*delay);
+    retry->timer.async_wait(
+        [this, retry](const boost::system::error_code& ec) {
+            if (ec || retry->done || retry->hedged ||
+                retry->outstanding == 0)
+            {
+                return;
+            }
+            startAttempt(retry, true);
+        });
+}
+
+void MCTPImpl::onAttemptDone(const std::shared_ptr<RetryRequest>& retry,
+                             boost::system::error_code ec,
+                             ByteArray& response)
+{
+    if (retry->done)
+    {
+        // Response of the slower copy of a hedged request
+        return;
+    }
+    // Compare as generic conditions, so a value of another error category
+    // does not match by accident
+    bool retryable =
+        ec && std::any_of(retry->policy.retryable.begin(),
+                          retry->policy.retryable.end(),
+                          [&ec](boost::system::errc::errc_t e) {
+                              return ec == boost::system::errc::
+                                               make_error_condition(e);
+                          });
+    bool attemptsLeft = retry->attempts < retry->policy.maxAttempts;
+    if (ec && retry->outstanding > 0)
+    {
+        // Other copy is still out. Let it decide
+        return;
+    }
+    if (ec && retryable && attemptsLeft)
+    {
+        retry->timer.expires_after(backoff(retry->policy, retry->attempts));
+        retry->timer.async_wait(
+            [this, retry](const boost::system::error_code& waitEc) {
+                if (!waitEc && !retry->done)
+                {
+                    startAttempt(retry, false);
+                }
+            });
+        return;
+    }
+    retry->done = true;
+    retry->timer.cancel();
+    if (retry->callback)
+    {
+        retry->callback(ec, response);
+    }
+}
+
+std::chrono::milliseconds MCTPImpl::backoff(const RetryPolicy& policy,
+                                            unsigned attempt)
+{
+    double delay = static_cast<double>(policy.initialBackoff.count());
+    for (unsigned i = 1; i < attempt; i++)
+    {
+        delay *= policy.backoffMultiplier;
+    }
+    delay = std::min(delay, static_cast<double>(policy.maxBackoff.count()));
+    double jitter = std::clamp(policy.jitter, 0.0, 1.0);
+    std::uniform_real_distribution<double> spread(1.0 - jitter, 1.0 + jitter);
+    return std::chrono::milliseconds(
+        static_cast<std::chrono::milliseconds::rep>(delay *
+                                                    spread(retryRandom)));
 }
 
 std::pair<boost::system::error_code, ByteArray>
-    MCTPImpl::sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
-                               const ByteArray& request,
-                               std::chrono::milliseconds timeout)
+    MCTPImpl::awaitResponse(
+        boost::asio::yield_context yield,
+        const std::function<void(ReceiveCallback)>& initiate)
 {
     auto receiveResult = std::make_pair(
         boost::system::errc::make_error_code(boost::system::errc::success),
         ByteArray());
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    auto token = yield[receiveResult.first];
+    receiveResult.second = boost::asio::async_initiate<
+        boost::asio::yield_context,
+        void(boost::system::error_code, ByteArray)>(
+        [&initiate](auto handler) {
+            auto sharedHandler =
+                std::make_shared<decltype(handler)>(std::move(handler));
+            initiate([sharedHandler](boost::system::error_code ec,
+                                     ByteArray& response) {
+                (*sharedHandler)(ec, std::move(response));
+            });
+        },
+        token);
+    return receiveResult;
+}
+
+// Append parts as one byte array argument. Bytes are copied once, straight
+// into the message
+static void appendPayload(sdbusplus::message::message& msg,
+                          ByteSpanList request)
+{
+    size_t size = 0;
+    for (const auto& part : request)
     {
-        phosphor::logging::log<phosphor::logging::level::DEBUG>(
-            "SendReceiveYield: Eid not found in end point map",
+        size += part.size();
+    }
+    void* buffer = nullptr;
+    int rc = sd_bus_message_append_array_space(msg.get(), 'y', size, &buffer);
+    if (rc < 0)
+    {
+        throw boost::system::system_error(
+            rc == -ENOMEM ? boost::system::errc::make_error_code(
+                                boost::system::errc::not_enough_memory)
+                          : boost::system::errc::make_error_code(
+                                boost::system::errc::invalid_argument),
+            "Unable to append payload");
+    }
+    auto dest = static_cast<uint8_t*>(buffer);
+    for (const auto& part : request)
+    {
+        if (!part.empty())
+        {
+            std::memcpy(dest, part.data(), part.size());
+            dest += part.size();
+        }
+    }
+}
+
+// mctpd takes the receive timeout as uint16_t milliseconds. Saturate instead
+// of wrapping around
+static uint16_t toMctpTimeout(std::chrono::milliseconds timeout)
+{
+    return static_cast<uint16_t>(
+        std::clamp<std::chrono::milliseconds::rep>(
+            timeout.count(), 0, std::numeric_limits<uint16_t>::max()));
+}
+
+// D-Bus timeout of a SendReceiveMctpMessagePayload call in microseconds. The
+// bus default is kept unless mctpd may need longer to report its own timeout.
+// 0 selects the default
+static uint64_t toBusTimeout(std::chrono::milliseconds timeout)
+{
+    constexpr std::chrono::milliseconds defaultBusTimeout{25000};
+    constexpr std::chrono::milliseconds margin{1000};
+    auto busTimeout = std::chrono::milliseconds(toMctpTimeout(timeout)) + margin;
+    if (busTimeout <= defaultBusTimeout)
+    {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(busTimeout)
+        .count();
+}
+
+sdbusplus::message::message
+    MCTPImpl::newSendReceiveCall(const std::string& service, DeviceID devID,
+                                 ByteSpanList request,
+                                 std::chrono::milliseconds timeout)
+{
+    auto msg = connection->new_method_call(
+        service.c_str(), "/xyz/openbmc_project/mctp",
+        "xyz.openbmc_project.MCTP.Base", "SendReceiveMctpMessagePayload");
+    msg.append(devID.mctpEID());
+    appendPayload(msg, request);
+    msg.append(toMctpTimeout(timeout));
+    return msg;
+}
+
+sdbusplus::message::message
+    MCTPImpl::newSendCall(const std::string& service, DeviceID devID,
+                          const uint8_t msgTag, const bool tagOwner,
+                          ByteSpanList request)
+{
+    auto msg = connection->new_method_call(
+        service.c_str(), "/xyz/openbmc_project/mctp",
+        "xyz.openbmc_project.MCTP.Base", "SendMctpMessagePayload");
+    msg.append(devID.mctpEID(), msgTag, tagOwner);
+    appendPayload(msg, request);
+    return msg;
+}
+
+void MCTPImpl::doSendReceiveAsync(ReceiveCallback callback,
+                                  const std::string& service, DeviceID devID,
+                                  ByteSpanList request,
+                                  std::chrono::milliseconds timeout,
+                                  std::function<bool()> takeSample)
+{
+    timeout = rttEstimator.timeout(devID, timeout);
+    sdbusplus::message::message msg;
+    try
+    {
+        msg = newSendReceiveCall(service, devID, request, timeout);
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            (std::string("SendReceiveAsync: ") + e.what()).c_str(),
             phosphor::logging::entry("EID=%d", devID.id));
-        receiveResult.first =
-            boost::system::errc::make_error_code(boost::system::errc::io_error);
-        return receiveResult;
+        ByteArray response;
+        if (callback)
+        {
+            callback(boost::system::errc::make_error_code(
+                         boost::system::errc::invalid_argument),
+                     response);
+        }
+        return;
     }
-    receiveResult.second = connection->yield_method_call<ByteArray>(
-        yield, receiveResult.first, it->second.second,
-        "/xyz/openbmc_project/mctp", "xyz.openbmc_project.MCTP.Base",
-        "SendReceiveMctpMessagePayload", devID.mctpEID(), request,
-        static_cast<uint16_t>(timeout.count()));
+    connection->async_send(
+        msg,
+        [this, devID, callback = std::move(callback),
+         takeSample = std::move(takeSample),
+         sent = std::chrono::steady_clock::now()](
+            boost::system::error_code ec, sdbusplus::message::message reply) {
+            ByteArray response;
+            if (!ec)
+            {
+                if (!takeSample || takeSample())
+                {
+                    rttEstimator.addSample(
+                        devID,
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - sent));
+                }
+                try
+                {
+                    reply.read(response);
+                }
+                catch (const std::exception&)
+                {
+                    ec = boost::system::errc::make_error_code(
+                        boost::system::errc::invalid_argument);
+                }
+            }
+            else if (ec == boost::system::errc::timed_out)
+            {
+                rttEstimator.onTimeout(devID);
+            }
+            if (callback)
+            {
+                callback(ec, response);
+            }
+        },
+        toBusTimeout(timeout));
+}
 
-    return receiveResult;
+std::pair<boost::system::error_code, ByteArray>
+    MCTPImpl::sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                               const ByteArray& request,
+                               std::chrono::milliseconds timeout,
+                               Priority priority, const RetryPolicy* policy)
+{
+    ByteSpan part(request);
+    return sendReceiveYield(yield, devID, ByteSpanList(&part, 1), timeout,
+                            priority, policy);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPImpl::sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                               ByteSpanList request,
+                               std::chrono::milliseconds timeout,
+                               Priority priority, const RetryPolicy* policy)
+{
+    return awaitResponse(yield, [this, devID, request, timeout, priority,
+                                 policy](ReceiveCallback callback) {
+        sendReceiveAsync(std::move(callback), devID, request, timeout,
+                         priority, policy);
+    });
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPImpl::sendReceiveYield(boost::asio::yield_context yield,
+                               const internal::ResolvedEndpoint& endpoint,
+                               const ByteArray& request,
+                               std::chrono::milliseconds timeout,
+                               Priority priority)
+{
+    return awaitResponse(yield, [this, &endpoint, &request, timeout,
+                                 priority](ReceiveCallback callback) {
+        sendReceiveAsync(std::move(callback), endpoint, request, timeout,
+                         priority);
+    });
 }
 
 boost::system::error_code
@@ -627,12 +1701,20 @@ boost::system::error_code
 std::pair<boost::system::error_code, ByteArray>
     MCTPImpl::sendReceiveBlocked(DeviceID devID, const ByteArray& request,
                                  std::chrono::milliseconds timeout)
+{
+    ByteSpan part(request);
+    return sendReceiveBlocked(devID, ByteSpanList(&part, 1), timeout);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPImpl::sendReceiveBlocked(DeviceID devID, ByteSpanList request,
+                                 std::chrono::milliseconds timeout)
 {
     auto receiveResult = std::make_pair(
         boost::system::errc::make_error_code(boost::system::errc::success),
         ByteArray());
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
         phosphor::logging::log<phosphor::logging::level::DEBUG>(
             "SendReceiveBlocked: Eid not found in end point map",
@@ -642,35 +1724,71 @@ std::pair<boost::system::error_code, ByteArray>
         return receiveResult;
     }
 
-    auto msg = connection->new_method_call(
-        it->second.second.c_str(), "/xyz/openbmc_project/mctp",
-        "xyz.openbmc_project.MCTP.Base", "SendReceiveMctpMessagePayload");
-
-    msg.append(devID.mctpEID());
-    msg.append(request);
-    msg.append(static_cast<uint16_t>(timeout.count()));
-
-    auto reply = connection->call(msg);
-    if (reply.is_method_error())
+    timeout = rttEstimator.timeout(devID, timeout);
+    sdbusplus::message::message msg;
+    try
     {
-        phosphor::logging::log<phosphor::logging::level::DEBUG>(
-            "SendReceiveBlocked: Error in method call ",
+        msg = newSendReceiveCall(endpointTable.serviceName(*entry), devID,
+                                 request, timeout);
+    }
+    catch (const boost::system::system_error& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            (std::string("SendReceiveBlocked: ") + e.what()).c_str(),
             phosphor::logging::entry("EID=%d", devID.id));
-        receiveResult.first =
-            boost::system::errc::make_error_code(boost::system::errc::io_error);
+        receiveResult.first = e.code();
         return receiveResult;
     }
-    reply.read(receiveResult.second);
 
-    return receiveResult;
+    auto sent = std::chrono::steady_clock::now();
+    sdbusplus::message::message reply;
+    try
+    {
+        reply = connection->call(msg, toBusTimeout(timeout));
+    }
+    catch (const sdbusplus::exception::SdBusError& e)
+    {
+        if (e.get_errno() == ETIMEDOUT)
+        {
+            rttEstimator.onTimeout(devID);
+        }
+        throw;
+    }
+    if (reply.is_method_error())
+    {
+        if (sd_bus_message_get_errno(reply.get()) == ETIMEDOUT)
+        {
+            rttEstimator.onTimeout(devID);
+        }
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "SendReceiveBlocked: Error in method call ",
+            phosphor::logging::entry("EID=%d", devID.id));
+        receiveResult.first =
+            boost::system::errc::make_error_code(boost::system::errc::io_error);
+        return receiveResult;
+    }
+    rttEstimator.addSample(
+        devID, std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - sent));
+    reply.read(receiveResult.second);
+
+    return receiveResult;
 }
 
 void MCTPImpl::sendAsync(const SendCallback& callback, const DeviceID devID,
                          const uint8_t msgTag, const bool tagOwner,
                          const ByteArray& request)
 {
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    ByteSpan part(request);
+    sendAsync(callback, devID, msgTag, tagOwner, ByteSpanList(&part, 1));
+}
+
+void MCTPImpl::sendAsync(const SendCallback& callback, const DeviceID devID,
+                         const uint8_t msgTag, const bool tagOwner,
+                         ByteSpanList request)
+{
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
         boost::system::error_code ec =
             boost::system::errc::make_error_code(boost::system::errc::io_error);
@@ -684,10 +1802,63 @@ void MCTPImpl::sendAsync(const SendCallback& callback, const DeviceID devID,
         return;
     }
 
-    connection->async_method_call(
-        callback, it->second.second, "/xyz/openbmc_project/mctp",
-        "xyz.openbmc_project.MCTP.Base", "SendMctpMessagePayload",
-        devID.mctpEID(), msgTag, tagOwner, request);
+    doSendAsync(callback, endpointTable.serviceName(*entry), devID, msgTag,
+                tagOwner, request);
+}
+
+void MCTPImpl::sendAsync(const SendCallback& callback,
+                         const internal::ResolvedEndpoint& endpoint,
+                         const uint8_t msgTag, const bool tagOwner,
+                         const ByteArray& request)
+{
+    ByteSpan part(request);
+    doSendAsync(callback, endpoint.service, endpoint.deviceId, msgTag,
+                tagOwner, ByteSpanList(&part, 1));
+}
+
+void MCTPImpl::doSendAsync(const SendCallback& callback,
+                           const std::string& service, const DeviceID devID,
+                           const uint8_t msgTag, const bool tagOwner,
+                           ByteSpanList request)
+{
+    sdbusplus::message::message msg;
+    try
+    {
+        msg = newSendCall(service, devID, msgTag, tagOwner, request);
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            (std::string("sendAsync: ") + e.what()).c_str(),
+            phosphor::logging::entry("EID=%d", devID.id));
+        if (callback)
+        {
+            callback(boost::system::errc::make_error_code(
+                         boost::system::errc::invalid_argument),
+                     -1);
+        }
+        return;
+    }
+    connection->async_send(msg, [callback](boost::system::error_code ec,
+                                           sdbusplus::message::message reply) {
+        int status = -1;
+        if (!ec)
+        {
+            try
+            {
+                reply.read(status);
+            }
+            catch (const std::exception&)
+            {
+                ec = boost::system::errc::make_error_code(
+                    boost::system::errc::invalid_argument);
+            }
+        }
+        if (callback)
+        {
+            callback(ec, status);
+        }
+    });
 }
 
 std::pair<boost::system::error_code, int>
@@ -695,8 +1866,17 @@ std::pair<boost::system::error_code, int>
                         const uint8_t msgTag, const bool tagOwner,
                         const ByteArray& request)
 {
-    auto it = this->endpointMap.find(devID);
-    if (this->endpointMap.end() == it)
+    ByteSpan part(request);
+    return sendYield(yield, devID, msgTag, tagOwner, ByteSpanList(&part, 1));
+}
+
+std::pair<boost::system::error_code, int>
+    MCTPImpl::sendYield(boost::asio::yield_context& yield, const DeviceID devID,
+                        const uint8_t msgTag, const bool tagOwner,
+                        ByteSpanList request)
+{
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
         phosphor::logging::log<phosphor::logging::level::DEBUG>(
             "sendYield: Eid not found in end point map",
@@ -705,403 +1885,1885 @@ std::pair<boost::system::error_code, int>
             boost::system::errc::make_error_code(boost::system::errc::io_error),
             -1);
     }
+    return doSendYield(yield, endpointTable.serviceName(*entry), devID, msgTag,
+                       tagOwner, request);
+}
 
+std::pair<boost::system::error_code, int>
+    MCTPImpl::sendYield(boost::asio::yield_context& yield,
+                        const internal::ResolvedEndpoint& endpoint,
+                        const uint8_t msgTag, const bool tagOwner,
+                        const ByteArray& request)
+{
+    ByteSpan part(request);
+    return doSendYield(yield, endpoint.service, endpoint.deviceId, msgTag,
+                       tagOwner, ByteSpanList(&part, 1));
+}
+
+std::pair<boost::system::error_code, int>
+    MCTPImpl::doSendYield(boost::asio::yield_context& yield,
+                          const std::string& service, const DeviceID devID,
+                          const uint8_t msgTag, const bool tagOwner,
+                          ByteSpanList request)
+{
     boost::system::error_code ec =
         boost::system::errc::make_error_code(boost::system::errc::success);
-    int status = connection->yield_method_call<int>(
-        yield, ec, it->second.second, "/xyz/openbmc_project/mctp",
-        "xyz.openbmc_project.MCTP.Base", "SendMctpMessagePayload",
-        devID.mctpEID(), msgTag, tagOwner, request);
+    int status = -1;
+    try
+    {
+        auto msg = newSendCall(service, devID, msgTag, tagOwner, request);
+        auto reply = connection->async_send(msg, yield[ec]);
+        if (!ec)
+        {
+            reply.read(status);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            (std::string("sendYield: ") + e.what()).c_str(),
+            phosphor::logging::entry("EID=%d", devID.id));
+        ec = boost::system::errc::make_error_code(
+            boost::system::errc::invalid_argument);
+    }
 
     return std::make_pair(ec, status);
 }
 
-void MCTPImpl::addToEidMap(boost::asio::yield_context yield,
-                           const std::string& serviceName)
+void MCTPImpl::sendRequestAsync(ReceiveCallback callback, DeviceID devID,
+                                ByteSpanList request,
+                                std::chrono::milliseconds timeout)
 {
-    int busID = 0;
-    try
+    auto fail = [&callback](boost::system::errc::errc_t error) {
+        ByteArray response;
+        if (callback)
+        {
+            callback(boost::system::errc::make_error_code(error), response);
+        }
+    };
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
     {
-        busID = getBusId(serviceName);
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "sendRequestAsync: Eid not found in end point map",
+            phosphor::logging::entry("EID=%d", devID.id));
+        fail(boost::system::errc::io_error);
+        return;
     }
-    catch (const std::exception& e)
+    auto tag = acquireTag(devID);
+    if (!tag)
     {
-        phosphor::logging::log<phosphor::logging::level::ERR>(
-            ("Error in getting getBusID from service" + serviceName + ". " +
-             e.what())
-                .c_str());
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "sendRequestAsync: No free message tag",
+            phosphor::logging::entry("EID=%d", devID.id));
+        fail(boost::system::errc::resource_unavailable_try_again);
         return;
     }
-    std::vector<std::pair<unsigned, std::string>> buses;
-    buses.emplace_back(busID, serviceName);
-    auto eidMap = buildMatchingEndpointMap(yield, buses);
-    this->endpointMap.insert(eidMap.begin(), eidMap.end());
+    if (!this->taggedRequestsUsed)
+    {
+        // Responses come as MessageReceivedSignal. Make sure it is matched
+        // on every service from now on
+        this->taggedRequestsUsed = true;
+        for (auto& [serviceName, serviceMatch] : this->serviceMatches)
+        {
+            addMessageReceivedMatch(serviceName, serviceMatch);
+        }
+    }
+
+    const uint64_t requestId = ++this->lastRequestId;
+    PendingRequest& pending = this->pendingRequests[pendingKey(devID, *tag)];
+    pending.id = requestId;
+    pending.callback = std::move(callback);
+    pending.timeout = timeout;
+    for (const auto& part : request)
+    {
+        size_t left = requestHeaderSize - pending.header.size();
+        size_t size = std::min(left, part.size());
+        pending.header.insert(pending.header.end(), part.begin(),
+                              part.begin() + size);
+    }
+    pending.timer = std::make_unique<boost::asio::steady_timer>(
+        connection->get_io_context(), timeout);
+    pending.timer->async_wait(
+        [this, devID, msgTag = *tag,
+         requestId](const boost::system::error_code& ec) {
+            if (ec == boost::asio::error::operation_aborted)
+            {
+                return;
+            }
+            completeTaggedRequest(devID, msgTag,
+                                  boost::system::errc::make_error_code(
+                                      boost::system::errc::timed_out),
+                                  {}, requestId);
+        });
+
+    doSendAsync(
+        [this, devID, msgTag = *tag, requestId](boost::system::error_code ec,
+                                                int status) {
+            if (!ec && status < 0)
+            {
+                ec = boost::system::errc::make_error_code(
+                    boost::system::errc::io_error);
+            }
+            if (ec)
+            {
+                phosphor::logging::log<phosphor::logging::level::DEBUG>(
+                    ("sendRequestAsync: Send failed. " + ec.message())
+                        .c_str(),
+                    phosphor::logging::entry("EID=%d", devID.id));
+                completeTaggedRequest(devID, msgTag, ec, {}, requestId);
+            }
+        },
+        endpointTable.serviceName(*entry), devID, *tag, true, request);
 }
 
-size_t MCTPImpl::eraseDevice(DeviceID extendedEID)
+std::pair<boost::system::error_code, ByteArray>
+    MCTPImpl::sendRequestYield(boost::asio::yield_context yield,
+                               DeviceID devID, ByteSpanList request,
+                               std::chrono::milliseconds timeout)
 {
-    return endpointMap.erase(extendedEID);
+    return awaitResponse(yield, [this, devID, request,
+                                 timeout](ReceiveCallback callback) {
+        sendRequestAsync(std::move(callback), devID, request, timeout);
+    });
 }
 
-std::optional<std::string>
-    MCTPImpl::getDeviceLocation(const DeviceID extendedEID)
+struct MCTPImpl::ManyRequest
+{
+    explicit ManyRequest(boost::asio::io_context& ioc) : deadline(ioc)
+    {
+    }
+    SendReceiveManyOptions options;
+    // Request bytes of all targets, back to back. Shared by all targets when
+    // the same request is sent to many endpoints
+    ByteArray payload;
+    std::vector<std::pair<size_t, size_t>> parts;
+    std::vector<SendReceiveResult> results;
+    std::vector<bool> done;
+    // Waiting target indexes grouped by mctp service
+    std::vector<std::string> services;
+    std::vector<std::deque<size_t>> waiting;
+    std::vector<size_t> serviceOf;
+    size_t nextService = 0;
+    size_t inFlight = 0;
+    size_t remaining = 0;
+    bool launching = false;
+    bool finished = false;
+    std::chrono::steady_clock::time_point expiry{};
+    boost::asio::steady_timer deadline;
+    SendReceiveManyResultCallback resultCallback;
+    SendReceiveManyCompleteCallback completeCallback;
+};
+
+void MCTPImpl::sendReceiveManyAsync(std::span<const SendReceiveTarget> targets,
+                                    const SendReceiveManyOptions& options,
+                                    SendReceiveManyResultCallback resultCb,
+                                    SendReceiveManyCompleteCallback completeCb)
+{
+    auto many = std::make_shared<ManyRequest>(connection->get_io_context());
+    many->options = options;
+    many->resultCallback = std::move(resultCb);
+    many->completeCallback = std::move(completeCb);
+    size_t size = 0;
+    for (const auto& target : targets)
+    {
+        size += target.request.size();
+    }
+    many->payload.reserve(size);
+    many->parts.reserve(targets.size());
+    many->results.reserve(targets.size());
+    for (const auto& target : targets)
+    {
+        many->parts.emplace_back(many->payload.size(), target.request.size());
+        many->payload.insert(many->payload.end(), target.request.begin(),
+                             target.request.end());
+        many->results.push_back({target.devID, {}, {}});
+    }
+    startManyRequest(many);
+}
+
+void MCTPImpl::sendReceiveManyAsync(std::span<const DeviceID> devIDs,
+                                    ByteSpan request,
+                                    const SendReceiveManyOptions& options,
+                                    SendReceiveManyResultCallback resultCb,
+                                    SendReceiveManyCompleteCallback completeCb)
 {
-    auto it = this->endpointMap.find(extendedEID);
-    if (it == this->endpointMap.end())
+    auto many = std::make_shared<ManyRequest>(connection->get_io_context());
+    many->options = options;
+    many->resultCallback = std::move(resultCb);
+    many->completeCallback = std::move(completeCb);
+    many->payload.assign(request.begin(), request.end());
+    many->parts.assign(devIDs.size(), std::make_pair(0, request.size()));
+    many->results.reserve(devIDs.size());
+    for (const auto& devID : devIDs)
+    {
+        many->results.push_back({devID, {}, {}});
+    }
+    startManyRequest(many);
+}
+
+void MCTPImpl::startManyRequest(const std::shared_ptr<ManyRequest>& many)
+{
+    size_t count = many->results.size();
+    if (count == 0)
     {
-        phosphor::logging::log<phosphor::logging::level::ERR>(
-            "getDeviceLocation: Eid not found in end point map",
-            phosphor::logging::entry("EID=%d", extendedEID.id));
-        return std::nullopt;
+        many->finished = true;
+        if (many->completeCallback)
+        {
+            many->completeCallback(many->results);
+        }
+        return;
     }
+    many->done.assign(count, false);
+    many->serviceOf.assign(count, 0);
+    many->remaining = count;
 
-    try
+    // Resolve every target once and group by service, so that one slow
+    // service cannot hold all concurrency slots
+    std::unordered_map<std::string_view, size_t> serviceIndex;
+    std::vector<size_t> unknown;
+    for (size_t index = 0; index < count; index++)
     {
-        auto locationCode = readPropertyValue<std::string>(
-            static_cast<sdbusplus::bus::bus&>(*connection), it->second.second,
-            "/xyz/openbmc_project/mctp/device/" +
-                std::to_string(extendedEID.mctpEID()),
-            "xyz.openbmc_project.Inventory.Decorator.LocationCode",
-            "LocationCode");
-        return locationCode.empty() ? std::nullopt
-                                    : std::make_optional(locationCode);
+        auto entry = this->endpointTable.find(many->results[index].devID);
+        if (!entry)
+        {
+            unknown.emplace_back(index);
+            continue;
+        }
+        const std::string& service = endpointTable.serviceName(*entry);
+        auto [it, inserted] =
+            serviceIndex.try_emplace(service, many->services.size());
+        if (inserted)
+        {
+            many->services.emplace_back(service);
+            many->waiting.emplace_back();
+        }
+        many->serviceOf[index] = it->second;
+        many->waiting[it->second].emplace_back(index);
     }
-    catch (const std::exception& e)
+
+    if (many->options.deadline.count() > 0)
     {
-        phosphor::logging::log<phosphor::logging::level::ERR>(
-            ("Error in getting Physical.Location property from " +
-             it->second.second + ". " + e.what())
-                .c_str());
-        return std::nullopt;
+        many->expiry =
+            std::chrono::steady_clock::now() + many->options.deadline;
+        many->deadline.expires_at(many->expiry);
+        many->deadline.async_wait(
+            [this, many](const boost::system::error_code& ec) {
+                if (!ec)
+                {
+                    expireManyRequest(many);
+                }
+            });
     }
+
+    for (size_t index : unknown)
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "SendReceiveMany: Eid not found in end point map",
+            phosphor::logging::entry("EID=%d", many->results[index].devID.id));
+        ByteArray response;
+        completeManyRequest(many, index,
+                            boost::system::errc::make_error_code(
+                                boost::system::errc::io_error),
+                            response);
+    }
+    launchManyRequest(many);
 }
 
-static eid_t readOwnEID(const std::string& serviceName,
-                        sdbusplus::asio::connection& connection)
+void MCTPImpl::launchManyRequest(const std::shared_ptr<ManyRequest>& many)
 {
-    static const std::string baseInterface = "xyz.openbmc_project.MCTP.Base";
-    static const std::string eidProperty = "Eid";
-    return readPropertyValue<eid_t>(connection, serviceName,
-                                    "/xyz/openbmc_project/mctp", baseInterface,
-                                    eidProperty);
+    // A request can complete synchronously and call back in here. The outer
+    // loop picks up the freed slot
+    if (many->launching)
+    {
+        return;
+    }
+    many->launching = true;
+    size_t serviceCount = many->waiting.size();
+    while (!many->finished && (many->options.concurrency == 0 ||
+                               many->inFlight < many->options.concurrency))
+    {
+        std::optional<size_t> index;
+        for (size_t tried = 0; tried < serviceCount && !index; tried++)
+        {
+            auto& queue = many->waiting[many->nextService];
+            many->nextService = (many->nextService + 1) % serviceCount;
+            if (!queue.empty())
+            {
+                index = queue.front();
+                queue.pop_front();
+            }
+        }
+        if (!index)
+        {
+            break;
+        }
+
+        auto timeout = many->options.timeout;
+        if (many->options.deadline.count() > 0)
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                many->expiry - std::chrono::steady_clock::now());
+            // timeout may be below 1ms, so std::clamp cannot be used
+            timeout = std::max(std::chrono::milliseconds(1),
+                               std::min(left, timeout));
+        }
+        const auto& [offset, size] = many->parts[*index];
+        ByteSpan part(many->payload.data() + offset, size);
+        many->inFlight++;
+        scheduleSendReceive(
+            [this, many, index = *index](boost::system::error_code ec,
+                                         ByteArray& response) {
+                many->inFlight--;
+                completeManyRequest(many, index, ec, response);
+            },
+            many->services[many->serviceOf[*index]],
+            many->results[*index].devID, ByteSpanList(&part, 1), timeout,
+            many->options.priority, config.retryPolicy);
+    }
+    many->launching = false;
 }
 
-void MCTPImpl::triggerGetOwnEID(const std::string& serviceName)
+void MCTPImpl::completeManyRequest(const std::shared_ptr<ManyRequest>& many,
+                                   size_t index, boost::system::error_code ec,
+                                   ByteArray& response)
 {
-    if (!this->eidChangeCallback)
+    if (many->finished || many->done[index])
     {
-        phosphor::logging::log<phosphor::logging::level::DEBUG>(
-            "GetOwnEIDs callback is empty while trying to trigger");
+        // Answered after the deadline
+        return;
+    }
+    many->done[index] = true;
+    auto& result = many->results[index];
+    result.ec = ec;
+    result.response = std::move(response);
+    --many->remaining;
+    if (many->resultCallback)
+    {
+        many->resultCallback(index, result);
+    }
+    if (many->remaining == 0)
+    {
+        many->finished = true;
+        many->deadline.cancel();
+        if (many->completeCallback)
+        {
+            many->completeCallback(many->results);
+        }
         return;
     }
+    launchManyRequest(many);
+}
 
-    try
+void MCTPImpl::expireManyRequest(const std::shared_ptr<ManyRequest>& many)
+{
+    if (many->finished)
     {
-        eid_t eid = readOwnEID(serviceName, *this->connection);
-        OwnEIDChange evt;
-        OwnEIDChange::EIDChangeData data;
-        data.eid = eid;
-        data.service = serviceName;
-        evt.context = &data;
-        this->eidChangeCallback(evt);
+        return;
     }
-    catch (const std::exception& e)
+    // Responses still outstanding are dropped when they arrive
+    many->finished = true;
+    for (size_t index = 0; index < many->results.size(); index++)
     {
-        phosphor::logging::log<phosphor::logging::level::WARNING>(
-            ("Wrapper: Error reading eid from " + serviceName + ". " + e.what())
-                .c_str());
+        if (many->done[index])
+        {
+            continue;
+        }
+        many->done[index] = true;
+        auto& result = many->results[index];
+        result.ec =
+            boost::system::errc::make_error_code(boost::system::errc::timed_out);
+        if (many->resultCallback)
+        {
+            many->resultCallback(index, result);
+        }
+    }
+    many->waiting.clear();
+    if (many->completeCallback)
+    {
+        many->completeCallback(many->results);
+    }
+}
+
+std::vector<SendReceiveResult> MCTPImpl::awaitManyRequest(
+    boost::asio::yield_context yield,
+    const std::function<void(SendReceiveManyCompleteCallback)>& initiate)
+{
+    struct Wait
+    {
+        explicit Wait(boost::asio::io_context& ioc) : done(ioc)
+        {
+        }
+        std::vector<SendReceiveResult> results;
+        bool complete = false;
+        boost::asio::steady_timer done;
+    };
+    auto wait = std::make_shared<Wait>(connection->get_io_context());
+    wait->done.expires_at(boost::asio::steady_timer::time_point::max());
+    initiate([wait](std::vector<SendReceiveResult>& results) {
+        wait->results = std::move(results);
+        wait->complete = true;
+        wait->done.cancel();
+    });
+    // All requests may complete before initiate returns
+    if (!wait->complete)
+    {
+        boost::system::error_code ec;
+        wait->done.async_wait(yield[ec]);
+    }
+    return std::move(wait->results);
+}
+
+std::vector<SendReceiveResult>
+    MCTPImpl::sendReceiveMany(boost::asio::yield_context yield,
+                              std::span<const SendReceiveTarget> targets,
+                              const SendReceiveManyOptions& options,
+                              SendReceiveManyResultCallback resultCb)
+{
+    return awaitManyRequest(
+        yield, [this, targets, &options, &resultCb](
+                   SendReceiveManyCompleteCallback completeCb) {
+            sendReceiveManyAsync(targets, options, std::move(resultCb),
+                                 std::move(completeCb));
+        });
+}
+
+std::vector<SendReceiveResult>
+    MCTPImpl::sendReceiveMany(boost::asio::yield_context yield,
+                              std::span<const DeviceID> devIDs,
+                              ByteSpan request,
+                              const SendReceiveManyOptions& options,
+                              SendReceiveManyResultCallback resultCb)
+{
+    return awaitManyRequest(
+        yield, [this, devIDs, request, &options,
+                &resultCb](SendReceiveManyCompleteCallback completeCb) {
+            sendReceiveManyAsync(devIDs, request, options, std::move(resultCb),
+                                 std::move(completeCb));
+        });
+}
+
+std::optional<uint8_t> MCTPImpl::acquireTag(DeviceID devID)
+{
+    uint8_t& inUse = this->tagsInUse[devID];
+    for (uint8_t tag = 0; tag < maxMessageTags; tag++)
+    {
+        if (!(inUse & (1 << tag)))
+        {
+            inUse |= static_cast<uint8_t>(1 << tag);
+            return tag;
+        }
+    }
+    return std::nullopt;
+}
+
+void MCTPImpl::quarantineTag(DeviceID devID, uint8_t msgTag,
+                             std::chrono::milliseconds timeout)
+{
+    auto timer = std::make_shared<boost::asio::steady_timer>(
+        connection->get_io_context(), timeout);
+    timer->async_wait([this, devID, msgTag,
+                       timer](const boost::system::error_code&) {
+        releaseTag(devID, msgTag);
+    });
+}
+
+bool MCTPImpl::isResponseTo(std::span<const uint8_t> requestHeader,
+                            std::span<const uint8_t> response)
+{
+    if (requestHeader.empty())
+    {
+        return true;
+    }
+    // Integrity check bit may differ
+    if (response.empty() || (response[0] & 0x7F) != (requestHeader[0] & 0x7F))
+    {
+        return false;
+    }
+    switch (static_cast<MessageType>(requestHeader[0] & 0x7F))
+    {
+        case MessageType::pldm:
+            // Request bit clear, same instance id, PLDM type and command
+            if (requestHeader.size() < 4)
+            {
+                return true;
+            }
+            return response.size() >= 4 && (response[1] & 0x80) == 0 &&
+                   (response[1] & 0x1F) == (requestHeader[1] & 0x1F) &&
+                   (response[2] & 0x3F) == (requestHeader[2] & 0x3F) &&
+                   response[3] == requestHeader[3];
+        case MessageType::spdm: {
+            // Response code is request code without bit 7, or ERROR
+            if (requestHeader.size() < 3)
+            {
+                return true;
+            }
+            constexpr uint8_t spdmError = 0x7F;
+            return response.size() >= 3 &&
+                   (response[2] == (requestHeader[2] & 0x7F) ||
+                    response[2] == spdmError);
+        }
+        default:
+            return true;
+    }
+}
+
+void MCTPImpl::releaseTag(DeviceID devID, uint8_t msgTag)
+{
+    auto it = this->tagsInUse.find(devID);
+    if (it == this->tagsInUse.end())
+    {
+        return;
+    }
+    it->second &= static_cast<uint8_t>(~(1 << msgTag));
+    if (it->second == 0)
+    {
+        this->tagsInUse.erase(it);
+    }
+}
+
+bool MCTPImpl::completeTaggedRequest(DeviceID devID, uint8_t msgTag,
+                                     boost::system::error_code ec,
+                                     std::span<const uint8_t> payload,
+                                     std::optional<uint64_t> requestId)
+{
+    auto it = this->pendingRequests.find(pendingKey(devID, msgTag));
+    if (it == this->pendingRequests.end() ||
+        (requestId && it->second.id != *requestId))
+    {
+        return false;
+    }
+    if (!ec && !isResponseTo(it->second.header, payload))
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "Message with tag of a pending request is not its response",
+            phosphor::logging::entry("EID=%d", devID.id));
+        return false;
+    }
+    PendingRequest pending = std::move(it->second);
+    this->pendingRequests.erase(it);
+    if (ec == boost::system::errc::timed_out)
+    {
+        quarantineTag(devID, msgTag, pending.timeout);
+    }
+    else
+    {
+        releaseTag(devID, msgTag);
+    }
+    pending.timer->cancel();
+
+    ByteArray response(payload.begin(), payload.end());
+    if (pending.callback)
+    {
+        pending.callback(ec, response);
+    }
+    return true;
+}
+
+void MCTPImpl::addToEidMap(boost::asio::yield_context yield,
+                           const std::string& serviceName)
+{
+    int busID = 0;
+    try
+    {
+        busID = getBusId(yield, serviceName);
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            ("Error in getting getBusID from service" + serviceName + ". " +
+             e.what())
+                .c_str());
+        return;
+    }
+    std::vector<std::pair<unsigned, std::string>> buses;
+    buses.emplace_back(busID, serviceName);
+    auto eidMap = buildMatchingEndpointMap(yield, buses);
+    for (const auto& [deviceId, service] : eidMap)
+    {
+        this->endpointTable.insert(deviceId, service.first, service.second);
+    }
+}
+
+size_t MCTPImpl::eraseDevice(DeviceID extendedEID)
+{
+    invalidateResolvedEndpoint(extendedEID);
+    responseCache.invalidate(extendedEID);
+    rttEstimator.erase(extendedEID);
+    circuitBreakers.erase(extendedEID);
+    return endpointTable.erase(extendedEID);
+}
+
+std::shared_ptr<internal::ResolvedEndpoint>
+    MCTPImpl::resolveEndpoint(DeviceID devID)
+{
+    auto cached = resolvedEndpoints.find(devID);
+    if (cached != resolvedEndpoints.end())
+    {
+        if (auto endpoint = cached->second.lock())
+        {
+            return endpoint;
+        }
+    }
+
+    auto entry = this->endpointTable.find(devID);
+    if (!entry)
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "resolveEndpoint: Eid not found in end point map",
+            phosphor::logging::entry("EID=%d", devID.id));
+        return nullptr;
+    }
+    auto endpoint = std::make_shared<internal::ResolvedEndpoint>();
+    endpoint->impl = this;
+    endpoint->deviceId = devID;
+    // Unique name saves the bus daemon from resolving the well known name on
+    // every call
+    endpoint->service =
+        canonicalServiceName(endpointTable.serviceName(*entry));
+    resolvedEndpoints.insert_or_assign(devID, endpoint);
+    return endpoint;
+}
+
+void MCTPImpl::invalidateResolvedEndpoint(DeviceID devID)
+{
+    auto it = resolvedEndpoints.find(devID);
+    if (it == resolvedEndpoints.end())
+    {
+        return;
+    }
+    if (auto endpoint = it->second.lock())
+    {
+        endpoint->impl = nullptr;
+    }
+    resolvedEndpoints.erase(it);
+}
+
+void MCTPImpl::pruneResolvedEndpoints()
+{
+    for (auto it = resolvedEndpoints.begin(); it != resolvedEndpoints.end();)
+    {
+        auto endpoint = it->second.lock();
+        if (endpoint && this->endpointTable.contains(it->first))
+        {
+            ++it;
+            continue;
+        }
+        if (endpoint)
+        {
+            endpoint->impl = nullptr;
+        }
+        it = resolvedEndpoints.erase(it);
+    }
+}
+
+static const std::string locationCodeInterface =
+    "xyz.openbmc_project.Inventory.Decorator.LocationCode";
+
+static std::string getDevicePath(const DeviceID extendedEID)
+{
+    return "/xyz/openbmc_project/mctp/device/" +
+           std::to_string(extendedEID.mctpEID());
+}
+
+std::optional<std::string>
+    MCTPImpl::getDeviceLocation(const DeviceID extendedEID)
+{
+    auto entry = this->endpointTable.find(extendedEID);
+    if (!entry)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            "getDeviceLocation: Eid not found in end point map",
+            phosphor::logging::entry("EID=%d", extendedEID.id));
+        return std::nullopt;
+    }
+
+    try
+    {
+        auto locationCode = readPropertyValue<std::string>(
+            static_cast<sdbusplus::bus::bus&>(*connection), endpointTable.serviceName(*entry),
+            getDevicePath(extendedEID), locationCodeInterface, "LocationCode");
+        return locationCode.empty() ? std::nullopt
+                                    : std::make_optional(locationCode);
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            ("Error in getting Physical.Location property from " +
+             endpointTable.serviceName(*entry) + ". " + e.what())
+                .c_str());
+        return std::nullopt;
+    }
+}
+
+std::optional<std::string>
+    MCTPImpl::getDeviceLocation(boost::asio::yield_context yield,
+                                const DeviceID extendedEID)
+{
+    auto entry = this->endpointTable.find(extendedEID);
+    if (!entry)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            "getDeviceLocation: Eid not found in end point map",
+            phosphor::logging::entry("EID=%d", extendedEID.id));
+        return std::nullopt;
+    }
+    // Endpoint map may change while yielding. Keep a copy of service name
+    std::string serviceName = endpointTable.serviceName(*entry);
+
+    try
+    {
+        auto locationCode = readPropertyValue<std::string>(
+            yield, *connection, serviceName, getDevicePath(extendedEID),
+            locationCodeInterface, "LocationCode");
+        return locationCode.empty() ? std::nullopt
+                                    : std::make_optional(locationCode);
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            ("Error in getting Physical.Location property from " +
+             serviceName + ". " + e.what())
+                .c_str());
+        return std::nullopt;
+    }
+}
+
+static eid_t readOwnEID(boost::asio::yield_context yield,
+                        const std::string& serviceName,
+                        sdbusplus::asio::connection& connection)
+{
+    static const std::string baseInterface = "xyz.openbmc_project.MCTP.Base";
+    static const std::string eidProperty = "Eid";
+    return readPropertyValue<eid_t>(yield, connection, serviceName,
+                                    "/xyz/openbmc_project/mctp", baseInterface,
+                                    eidProperty);
+}
+
+void MCTPImpl::triggerGetOwnEID(const std::string& serviceName)
+{
+    if (!this->eidChangeCallback)
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "GetOwnEIDs callback is empty while trying to trigger");
+        return;
+    }
+
+    if (auto properties = getCachedServiceProperties(
+            serviceName, "xyz.openbmc_project.MCTP.Base"))
+    {
+        if (auto eid = getProperty<eid_t>(*properties, "Eid"))
+        {
+            this->onOwnEIDChange(serviceName, *eid);
+            return;
+        }
+    }
+
+    boost::asio::spawn(
+        connection->get_io_context(),
+        [this, serviceName](boost::asio::yield_context yield) {
+            try
+            {
+                std::optional<eid_t> eid;
+                if (auto properties = getServiceProperties(
+                        yield, serviceName, "xyz.openbmc_project.MCTP.Base"))
+                {
+                    eid = getProperty<eid_t>(*properties, "Eid");
+                }
+                if (!eid)
+                {
+                    eid = readOwnEID(yield, serviceName, *this->connection);
+                }
+                this->onOwnEIDChange(serviceName, *eid);
+            }
+            catch (const std::exception& e)
+            {
+                phosphor::logging::log<phosphor::logging::level::WARNING>(
+                    ("Wrapper: Error reading eid from " + serviceName + ". " +
+                     e.what())
+                        .c_str());
+            }
+        });
+}
+
+void MCTPImpl::getOwnEIDs(OwnEIDChangeCallback callback)
+{
+    if (!callback)
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            "GetOwnEIDs callback is empty");
+        return;
+    }
+
+    this->eidChangeCallback = callback;
+
+    auto matchedBusesCopy = matchedBuses;
+    for (const auto& service : matchedBusesCopy)
+    {
+        triggerGetOwnEID(service);
+    }
+}
+
+std::optional<NetworkID>
+    MCTPImpl::getCachedNetworkID(const std::string& serviceName) const
+{
+    auto it = this->networkIDCache.find(serviceName);
+    if (it != this->networkIDCache.end())
+    {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+NetworkID MCTPImpl::getNetworkID(boost::asio::yield_context yield,
+                                 const std::string& serviceName)
+{
+    if (auto cached = getCachedNetworkID(serviceName))
+    {
+        return *cached;
+    }
+
+    if (auto properties = getServiceProperties(
+            yield, serviceName, "xyz.openbmc_project.MCTP.Base"))
+    {
+        auto networkID = getProperty<NetworkID>(*properties, "NetworkID");
+        if (!networkID)
+        {
+            phosphor::logging::log<phosphor::logging::level::WARNING>(
+                ("NetworkID property not found in " + serviceName +
+                 ". Assuming EIDs wont overlap")
+                    .c_str());
+        }
+        this->networkIDCache.emplace(serviceName, networkID.value_or(0));
+        return networkID.value_or(0);
+    }
+
+    try
+    {
+        auto networkID = readPropertyValue<NetworkID>(
+            yield, *this->connection, serviceName, "/xyz/openbmc_project/mctp",
+            "xyz.openbmc_project.MCTP.Base", "NetworkID");
+        this->networkIDCache.emplace(serviceName, networkID);
+        return networkID;
+    }
+    catch (const std::exception&)
+    {
+        phosphor::logging::log<phosphor::logging::level::WARNING>(
+            ("NetworkID property not found in " + serviceName +
+             ". Assuming EIDs wont overlap")
+                .c_str());
+    }
+    return 0;
+}
+
+DeviceID MCTPImpl::getDeviceIDFromPath(
+    boost::asio::yield_context yield,
+    const sdbusplus::message::object_path& objectPath,
+    const std::string& serviceName)
+{
+    try
+    {
+        auto slashLoc = objectPath.str.find_last_of('/');
+        if (objectPath.str.npos == slashLoc || slashLoc < 2)
+        {
+            throw std::runtime_error("Invalid device path");
+        }
+
+        auto strEID = objectPath.str.substr(slashLoc + 1);
+        auto networkID = getNetworkID(yield, serviceName);
+        return DeviceID(std::stoi(strEID), networkID);
+    }
+    catch (const std::exception& e)
+    {
+        throw std::runtime_error(std::string("Error getting eid from ") +
+                                 objectPath.str + ". " + e.what());
+    }
+}
+
+static const std::string mctpSignalRule =
+    "type='signal',path='/xyz/openbmc_project/mctp',";
+
+void MCTPImpl::listenForMCTPChanges()
+{
+    // Only new services are of interest from unknown senders. Other signals
+    // are matched per service in registerListeners
+    static const std::string rule =
+        mctpSignalRule +
+        "interface='org.freedesktop.DBus.ObjectManager',"
+        "member='InterfacesAdded'";
+
+    this->mctpChangesWatch = std::make_unique<sdbusplus::bus::match::match>(
+        *connection, rule,
+        std::bind(&MCTPImpl::onMCTPEvent, this, std::placeholders::_1));
+
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        "Wrapper: Listening for new MCTP services and endpoints");
+}
+
+void MCTPImpl::registerListeners(const std::string& serviceName)
+{
+    auto [it, inserted] = this->serviceMatches.try_emplace(serviceName);
+    if (!inserted)
+    {
+        return;
+    }
+    const std::string senderRule =
+        mctpSignalRule + "sender='" + serviceName + "',";
+    std::vector<std::string> rules = {
+        senderRule + "interface='org.freedesktop.DBus.ObjectManager',"
+                     "member='InterfacesRemoved'",
+        senderRule + "interface='org.freedesktop.DBus.Properties',"
+                     "member='PropertiesChanged',"
+                     "arg0='xyz.openbmc_project.MCTP.Base'"};
+    const auto& bindingInterface =
+        mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType);
+    if (!bindingInterface.empty())
+    {
+        rules.emplace_back(senderRule +
+                           "interface='org.freedesktop.DBus.Properties',"
+                           "member='PropertiesChanged',arg0='" +
+                           bindingInterface + "'");
+    }
+    for (const auto& rule : rules)
+    {
+        it->second.matches.emplace_back(
+            std::make_unique<sdbusplus::bus::match::match>(
+                *connection, rule,
+                std::bind(&MCTPImpl::onMCTPEvent, this,
+                          std::placeholders::_1)));
+    }
+    // Owner change comes from the bus daemon. Catches mctpd exiting without
+    // removing its interfaces
+    it->second.matches.emplace_back(
+        std::make_unique<sdbusplus::bus::match::match>(
+            *connection,
+            "type='signal',sender='org.freedesktop.DBus',"
+            "interface='org.freedesktop.DBus',member='NameOwnerChanged',"
+            "arg0='" +
+                serviceName + "'",
+            std::bind(&MCTPImpl::onNameOwnerChanged, this,
+                      std::placeholders::_1)));
+    if (needsMessageReceivedMatch())
+    {
+        addMessageReceivedMatch(serviceName, it->second);
+    }
+    phosphor::logging::log<phosphor::logging::level::DEBUG>(
+        ("Listening for signals from " + serviceName).c_str());
+}
+
+void MCTPImpl::addMessageReceivedMatch(const std::string& serviceName,
+                                       ServiceMatches& serviceMatch)
+{
+    if (serviceMatch.messageReceived)
+    {
+        return;
+    }
+    const std::string rule = mctpSignalRule + "sender='" + serviceName +
+                             "',interface='xyz.openbmc_project.MCTP.Base',"
+                             "member='MessageReceivedSignal'";
+    serviceMatch.messageReceived =
+        std::make_unique<sdbusplus::bus::match::match>(
+            *connection, rule,
+            std::bind(&MCTPImpl::onMCTPEvent, this, std::placeholders::_1));
+}
+
+void MCTPImpl::unRegisterListeners(const std::string& serviceName)
+{
+    auto it = this->serviceMatches.find(serviceName);
+    if (it == this->serviceMatches.end())
+    {
+        return;
+    }
+    // Called from signal handlers of these matches. Destroy them once the
+    // handler has returned
+    auto matches = std::make_shared<ServiceMatches>(std::move(it->second));
+    this->serviceMatches.erase(it);
+    boost::asio::post(connection->get_io_context(),
+                      [matches]() mutable { matches.reset(); });
+}
+
+void MCTPImpl::onNewService(const std::string& serviceName)
+{
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        (std::string("New service ") + serviceName).c_str());
+    matchedBuses.emplace(serviceName);
+    registerListeners(serviceName);
+    registerResponder(serviceName);
+
+    triggerGetOwnEID(serviceName);
+
+    // Mapping of the well known name was dropped when the service left.
+    // Restore it whether or not endpoints were held as stale
+    boost::asio::spawn(connection->get_io_context(),
+                       [this, serviceName](boost::asio::yield_context yield) {
+                           mapReturningService(yield, serviceName);
+                       });
+}
+
+void MCTPImpl::emitNetworkChangeEvent(Event::EventType type,
+                                      DeviceID deviceID)
+{
+    mctpw::Event event;
+    event.type = type;
+    event.eid = deviceID.mctpEID();
+    event.deviceId = deviceID;
+    if (isFlapping(event))
+    {
+        return;
+    }
+    if (config.eventBatchWindow.count() > 0)
+    {
+        batchNetworkChangeEvent(event);
+        return;
+    }
+    deliverNetworkChangeEvent(event);
+}
+
+void MCTPImpl::deliverNetworkChangeEvent(const Event& event)
+{
+    if (!this->networkChangeCallback)
+    {
+        return;
+    }
+    boost::asio::spawn(connection->get_io_context(),
+                       [this, event](boost::asio::yield_context yield) {
+                           this->networkChangeCallback(this, event, yield);
+                       });
+}
+
+void MCTPImpl::emitNetworkChangeEvents(std::vector<Event> events)
+{
+    std::erase_if(events,
+                  [this](const Event& event) { return isFlapping(event); });
+    postNetworkChangeEvents(std::move(events));
+}
+
+void MCTPImpl::postNetworkChangeEvents(std::vector<Event> events)
+{
+    if (events.empty())
+    {
+        return;
+    }
+    if (config.eventBatchWindow.count() > 0)
+    {
+        for (const auto& event : events)
+        {
+            batchNetworkChangeEvent(event);
+        }
+        return;
+    }
+    if (!this->batchNetworkChangeCallback)
+    {
+        for (const auto& event : events)
+        {
+            deliverNetworkChangeEvent(event);
+        }
+        return;
+    }
+    boost::asio::spawn(
+        connection->get_io_context(),
+        [this, events = std::move(events)](boost::asio::yield_context yield) {
+            this->batchNetworkChangeCallback(this, events, yield);
+        });
+}
+
+bool MCTPImpl::isFlapping(const Event& event)
+{
+    switch (this->flapDetector.onEvent(event))
+    {
+        case internal::FlapDetector::Verdict::report:
+            return false;
+        case internal::FlapDetector::Verdict::quarantine:
+            phosphor::logging::log<phosphor::logging::level::WARNING>(
+                ("EID " + std::to_string(event.deviceId.mctpEID()) +
+                 " is flapping. Suppressing its events")
+                    .c_str());
+            scheduleFlapRelease();
+            return true;
+        case internal::FlapDetector::Verdict::suppress:
+            scheduleFlapRelease();
+            return true;
+    }
+    return false;
+}
+
+void MCTPImpl::scheduleFlapRelease()
+{
+    auto next = this->flapDetector.nextRelease();
+    if (!next)
+    {
+        return;
+    }
+    if (!this->flapReleaseTimer)
+    {
+        this->flapReleaseTimer = std::make_unique<boost::asio::steady_timer>(
+            connection->get_io_context());
+    }
+    this->flapReleaseTimer->expires_at(*next);
+    this->flapReleaseTimer->async_wait(
+        [this](const boost::system::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+            auto events = this->flapDetector.release();
+            for (const auto& event : events)
+            {
+                phosphor::logging::log<phosphor::logging::level::INFO>(
+                    ("EID " + std::to_string(event.deviceId.mctpEID()) +
+                     " settled. Reporting its state")
+                        .c_str());
+            }
+            postNetworkChangeEvents(std::move(events));
+            scheduleFlapRelease();
+        });
+}
+
+void MCTPImpl::batchNetworkChangeEvent(const Event& event)
+{
+    auto it = std::find_if(this->batchedEvents.begin(),
+                           this->batchedEvents.end(),
+                           [&event](const Event& batched) {
+                               return batched.deviceId == event.deviceId;
+                           });
+    if (it != this->batchedEvents.end())
+    {
+        if (it->type != event.type)
+        {
+            // Added and removed within the window. Nothing to report
+            this->batchedEvents.erase(it);
+        }
+        return;
+    }
+    this->batchedEvents.emplace_back(event);
+
+    if (!this->eventBatchTimer)
+    {
+        this->eventBatchTimer = std::make_unique<boost::asio::steady_timer>(
+            connection->get_io_context());
+    }
+    if (this->batchedEvents.size() == 1)
+    {
+        this->eventBatchTimer->expires_after(config.eventBatchWindow);
+        this->eventBatchTimer->async_wait(
+            [this](const boost::system::error_code& ec) {
+                if (!ec)
+                {
+                    flushNetworkChangeEvents();
+                }
+            });
+    }
+}
+
+void MCTPImpl::flushNetworkChangeEvents()
+{
+    std::vector<Event> events = std::move(this->batchedEvents);
+    this->batchedEvents.clear();
+    if (events.empty())
+    {
+        return;
+    }
+    if (this->batchNetworkChangeCallback)
+    {
+        boost::asio::spawn(connection->get_io_context(),
+                           [this, events = std::move(events)](
+                               boost::asio::yield_context yield) {
+                               this->batchNetworkChangeCallback(this, events,
+                                                                yield);
+                           });
+    }
+    else if (this->networkChangeCallback)
+    {
+        // One coroutine for the whole batch
+        boost::asio::spawn(connection->get_io_context(),
+                           [this, events = std::move(events)](
+                               boost::asio::yield_context yield) {
+                               for (const auto& event : events)
+                               {
+                                   this->networkChangeCallback(this, event,
+                                                               yield);
+                               }
+                           });
+    }
+}
+
+void MCTPImpl::setBatchReconfigurationCallback(
+    BatchReconfigurationCallback callback)
+{
+    this->batchNetworkChangeCallback = std::move(callback);
+}
+
+void MCTPImpl::onNewEID(const std::string& serviceName, DeviceID extendedEID,
+                        bool replayed)
+{
+    if (replayed && this->endpointTable.contains(extendedEID))
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            ("Replayed EID already found by discovery " +
+             std::to_string(extendedEID.mctpEID()))
+                .c_str());
+        return;
+    }
+    this->endpointTable.insert(extendedEID, 0, serviceName);
+    responseCache.invalidate(extendedEID);
+    rttEstimator.erase(extendedEID);
+    circuitBreakers.erase(extendedEID);
+    if (takeStaleEndpoint(extendedEID))
+    {
+        // Returned with its restarted service. Nothing changed for the user
+        return;
+    }
+    emitNetworkChangeEvent(mctpw::Event::EventType::deviceAdded, extendedEID);
+}
+
+void MCTPImpl::onNewInterface(sdbusplus::message::message& msg,
+                              bool replayed)
+{
+    InterfaceMap values;
+    sdbusplus::message::object_path objectPath;
+
+    msg.read(objectPath, values);
+    phosphor::logging::log<phosphor::logging::level::DEBUG>(
+        (std::string("Interface added on ") + objectPath.str).c_str());
+
+    if (objectPath.str == "/xyz/openbmc_project/mctp")
+    {
+        // Interface added on base object. Means new service.
+        if (values.end() !=
+            values.find(
+                mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType)))
+        {
+            this->onNewService(msg.get_sender());
+        }
+        return;
+    }
+
+    if (!matchedBuses.contains(msg.get_sender()))
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            (std::string("Ignoring service not in interset: ") +
+             msg.get_sender())
+                .c_str());
+        return;
+    }
+
+    // TODO Check for /xyz/openbmc_project/mctp/\d+ using regex
+    if (objectPath.str.starts_with("/xyz/openbmc_project/mctp/"))
+    {
+        // Interface added on base endpoint object. Means new EID
+        auto itSupportedMsgTypes =
+            values.find("xyz.openbmc_project.MCTP.SupportedMessageTypes");
+        if (values.end() != itSupportedMsgTypes)
+        {
+            if (isMatchingEndpoint(objectPath, values))
+            {
+                boost::asio::spawn(
+                    connection->get_io_context(),
+                    [this, objectPath, replayed,
+                     serviceName = std::string(msg.get_sender())](
+                        boost::asio::yield_context yield) {
+                        try
+                        {
+                            auto newExtendedEID = getDeviceIDFromPath(
+                                yield, objectPath, serviceName);
+                            this->onNewEID(serviceName, newExtendedEID,
+                                           replayed);
+                        }
+                        catch (const std::exception& e)
+                        {
+                            phosphor::logging::log<
+                                phosphor::logging::level::INFO>(
+                                (std::string("Error in new eid callback ") +
+                                 e.what())
+                                    .c_str());
+                        }
+                    });
+            }
+        }
+    }
+}
+
+void MCTPImpl::onEIDRemoved(DeviceID deviceID)
+{
+    if (eraseDevice(deviceID) == 0)
+    {
+        phosphor::logging::log<phosphor::logging::level::DEBUG>(
+            ("Removed device is not in endpoint map " +
+             std::to_string(deviceID.mctpEID()))
+                .c_str());
+        return;
+    }
+    emitNetworkChangeEvent(mctpw::Event::EventType::deviceRemoved, deviceID);
+}
+
+void MCTPImpl::onInterfaceRemoved(sdbusplus::message::message& msg)
+{
+    sdbusplus::message::object_path objectPath;
+    std::vector<std::string> interfaces;
+    msg.read(objectPath, interfaces);
+
+    if (objectPath.str.starts_with("/xyz/openbmc_project/mctp/"))
+    {
+        if (std::find(interfaces.begin(), interfaces.end(),
+                      "xyz.openbmc_project.MCTP.SupportedMessageTypes") !=
+            interfaces.end())
+        {
+            boost::asio::spawn(
+                connection->get_io_context(),
+                [this, objectPath,
+                 serviceName = std::string(msg.get_sender())](
+                    boost::asio::yield_context yield) {
+                    try
+                    {
+                        auto deviceID =
+                            getDeviceIDFromPath(yield, objectPath, serviceName);
+                        // Cannot check values of the interface since its
+                        // removed
+                        this->onEIDRemoved(deviceID);
+                    }
+                    catch (const std::exception& e)
+                    {
+
+                        phosphor::logging::log<
+                            phosphor::logging::level::INFO>(
+                            (std::string("Error in eid remove callback ") +
+                             e.what())
+                                .c_str());
+                    }
+                });
+        }
+    }
+    else if (objectPath.str == "/xyz/openbmc_project/mctp")
+    {
+        if (std::find(interfaces.begin(), interfaces.end(),
+                      "xyz.openbmc_project.MCTP.Base") != interfaces.end())
+        {
+            onServiceLost(msg.get_sender());
+        }
+    }
+}
+
+void MCTPImpl::onNameOwnerChanged(sdbusplus::message::message& msg)
+{
+    std::string name;
+    std::string oldOwner;
+    std::string newOwner;
+    try
+    {
+        msg.read(name, oldOwner, newOwner);
+    }
+    catch (const std::exception& e)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            (std::string("NameOwnerChanged: ") + e.what()).c_str());
+        return;
+    }
+    if (newOwner.empty())
+    {
+        onServiceLost(name);
+    }
+}
+
+void MCTPImpl::onServiceLost(const std::string& serviceName)
+{
+    if (this->matchedBuses.erase(serviceName) == 0)
+    {
+        // Already handled through the other signal
+        return;
+    }
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        ("Removing mctp service " + serviceName).c_str());
+    unRegisterListeners(serviceName);
+    eraseServiceProperties(serviceName);
+
+    // Endpoints may be stored under the well known name as well
+    std::unordered_set<std::string> names{serviceName};
+    for (auto it = this->uniqueNames.begin(); it != this->uniqueNames.end();)
+    {
+        if (it->second == serviceName)
+        {
+            names.emplace(it->first);
+            it = this->uniqueNames.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    // A restarted mctpd may report another network id
+    for (const auto& name : names)
+    {
+        this->networkIDCache.erase(name);
+    }
+
+    std::vector<DeviceID> lost;
+    EndpointMapExtended lostEndpoints;
+    for (const auto& [deviceId, service] : this->endpointTable.view())
+    {
+        if (names.contains(service.second))
+        {
+            lost.emplace_back(deviceId);
+            lostEndpoints.emplace(deviceId, service);
+        }
+    }
+    std::vector<Event> events;
+    events.reserve(lost.size());
+    for (const auto& deviceId : lost)
+    {
+        eraseDevice(deviceId);
+        mctpw::Event event;
+        event.type = mctpw::Event::EventType::deviceRemoved;
+        event.eid = deviceId.mctpEID();
+        event.deviceId = deviceId;
+        events.emplace_back(event);
+    }
+    // Handles resolved to the unique name can not reach the new instance of
+    // the service
+    for (auto it = resolvedEndpoints.begin(); it != resolvedEndpoints.end();)
+    {
+        auto endpoint = it->second.lock();
+        if (endpoint && !names.contains(endpoint->service))
+        {
+            ++it;
+            continue;
+        }
+        if (endpoint)
+        {
+            endpoint->impl = nullptr;
+        }
+        it = resolvedEndpoints.erase(it);
+    }
+
+    // Nothing will answer the outstanding requests. Fail them now instead of
+    // letting them wait for their timeout
+    auto aborted = boost::system::errc::make_error_code(
+        boost::system::errc::connection_aborted);
+    for (const auto& name : names)
+    {
+        for (const auto& scheduled : scheduler.requestsOf(name))
+        {
+            ByteArray response;
+            finishScheduledRequest(scheduled, aborted, response);
+        }
+    }
+    std::unordered_set<DeviceID> lostSet(lost.begin(), lost.end());
+    std::vector<uint32_t> pendingKeys;
+    for (const auto& [key, pending] : this->pendingRequests)
+    {
+        DeviceID devID;
+        devID.id = key >> 3;
+        if (lostSet.contains(devID))
+        {
+            pendingKeys.emplace_back(key);
+        }
+    }
+    for (uint32_t key : pendingKeys)
+    {
+        DeviceID devID;
+        devID.id = key >> 3;
+        completeTaggedRequest(devID, static_cast<uint8_t>(key & 0x07), aborted,
+                              {});
+    }
+
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        ("Removed " + std::to_string(lost.size()) + " endpoints of " +
+         serviceName)
+            .c_str());
+    names.erase(serviceName);
+    if (config.staleHoldTime.count() > 0 && !names.empty() && !lost.empty())
+    {
+        holdStaleEndpoints(*names.begin(), serviceName,
+                           std::move(lostEndpoints));
+        return;
+    }
+    emitNetworkChangeEvents(std::move(events));
+}
+
+void MCTPImpl::holdStaleEndpoints(const std::string& wellKnownName,
+                                  const std::string& uniqueName,
+                                  EndpointMapExtended endpoints)
+{
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        ("Holding " + std::to_string(endpoints.size()) +
+         " endpoints of " + wellKnownName + " as stale")
+            .c_str());
+    StaleService& stale = this->staleServices[wellKnownName];
+    stale.uniqueName = uniqueName;
+    stale.endpoints.merge(endpoints);
+    stale.timer = std::make_unique<boost::asio::steady_timer>(
+        connection->get_io_context());
+    stale.timer->expires_after(config.staleHoldTime);
+    stale.timer->async_wait(
+        [this, wellKnownName](const boost::system::error_code& ec) {
+            if (!ec)
+            {
+                expireStaleService(wellKnownName);
+            }
+        });
+}
+
+void MCTPImpl::expireStaleService(const std::string& wellKnownName)
+{
+    auto it = this->staleServices.find(wellKnownName);
+    if (it == this->staleServices.end())
+    {
+        return;
+    }
+    std::vector<Event> events;
+    for (const auto& [deviceId, service] : it->second.endpoints)
+    {
+        mctpw::Event event;
+        event.type = mctpw::Event::EventType::deviceRemoved;
+        event.eid = deviceId.mctpEID();
+        event.deviceId = deviceId;
+        events.emplace_back(event);
+    }
+    this->staleServices.erase(it);
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        (wellKnownName + " did not return. Removing " +
+         std::to_string(events.size()) + " endpoints")
+            .c_str());
+    emitNetworkChangeEvents(std::move(events));
+}
+
+bool MCTPImpl::takeStaleEndpoint(DeviceID devID)
+{
+    for (auto& [name, stale] : this->staleServices)
+    {
+        if (stale.endpoints.erase(devID) > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MCTPImpl::mapReturningService(boost::asio::yield_context yield,
+                                   const std::string& uniqueName)
+{
+    std::vector<std::string> candidates(this->wellKnownNames.begin(),
+                                        this->wellKnownNames.end());
+    for (const auto& [name, stale] : this->staleServices)
+    {
+        if (!this->wellKnownNames.contains(name))
+        {
+            candidates.emplace_back(name);
+        }
+    }
+    std::optional<std::string> wellKnownName;
+    for (const auto& name : candidates)
+    {
+        boost::system::error_code ec;
+        auto owner = connection->yield_method_call<std::string>(
+            yield, ec, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+            "org.freedesktop.DBus", "GetNameOwner", name);
+        if (!ec && owner == uniqueName)
+        {
+            wellKnownName = name;
+            break;
+        }
     }
-}
-
-void MCTPImpl::getOwnEIDs(OwnEIDChangeCallback callback)
-{
-    if (!callback)
+    if (!wellKnownName)
     {
-        phosphor::logging::log<phosphor::logging::level::DEBUG>(
-            "GetOwnEIDs callback is empty");
         return;
     }
+    this->uniqueNames[*wellKnownName] = uniqueName;
+    this->wellKnownNames.emplace(*wellKnownName);
 
-    this->eidChangeCallback = callback;
-
-    auto matchedBusesCopy = matchedBuses;
-    for (const auto& service : matchedBusesCopy)
+    if (this->staleServices.contains(*wellKnownName))
     {
-        triggerGetOwnEID(service);
+        reconcileStaleService(yield, *wellKnownName);
     }
 }
 
-uint8_t MCTPImpl::getNetworkID(const std::string& serviceName)
+void MCTPImpl::reconcileStaleService(boost::asio::yield_context yield,
+                                     const std::string& wellKnownName)
 {
-    auto it = this->networkIDCache.find(serviceName);
-    if (it != this->networkIDCache.end())
-    {
-        return it->second;
-    }
-
+    EndpointMapExtended current;
     try
     {
-        auto networkID = readPropertyValue<NetworkID>(
-            *this->connection, serviceName, "/xyz/openbmc_project/mctp",
-            "xyz.openbmc_project.MCTP.Base", "NetworkID");
-        this->networkIDCache.emplace(serviceName, networkID);
+        std::vector<std::pair<unsigned, std::string>> buses;
+        buses.emplace_back(getBusId(yield, wellKnownName), wellKnownName);
+        current = buildMatchingEndpointMap(yield, buses);
     }
-    catch (const std::exception&)
+    catch (const std::exception& e)
     {
-        phosphor::logging::log<phosphor::logging::level::WARNING>(
-            ("NetworkID property not found in " + serviceName +
-             ". Assuming EIDs wont overlap")
+        // Stale endpoints expire as usual. Endpoints are still added through
+        // InterfacesAdded
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            ("Reconcile of " + wellKnownName + " failed. " + e.what())
                 .c_str());
+        return;
     }
-    return 0;
-}
 
-DeviceID MCTPImpl::getDeviceIDFromPath(
-    const sdbusplus::message::object_path& objectPath,
-    const std::string& serviceName)
-{
-    try
+    auto it = this->staleServices.find(wellKnownName);
+    if (it == this->staleServices.end())
     {
-        auto slashLoc = objectPath.str.find_last_of('/');
-        if (objectPath.str.npos == slashLoc || slashLoc < 2)
+        // Expired while the endpoints were read
+        return;
+    }
+    StaleService& stale = it->second;
+
+    std::vector<Event> events;
+    size_t adopted = 0;
+    for (const auto& [deviceId, service] : current)
+    {
+        bool wasStale = stale.endpoints.erase(deviceId) > 0;
+        bool present = this->endpointTable.contains(deviceId);
+        this->endpointTable.insert_or_assign(deviceId, service.first,
+                                             service.second);
+        if (wasStale)
         {
-            throw std::runtime_error("Invalid device path");
+            adopted++;
+        }
+        else if (!present)
+        {
+            mctpw::Event event;
+            event.type = mctpw::Event::EventType::deviceAdded;
+            event.eid = deviceId.mctpEID();
+            event.deviceId = deviceId;
+            events.emplace_back(event);
         }
-
-        auto strEID = objectPath.str.substr(slashLoc + 1);
-        auto networkID = getNetworkID(serviceName);
-        return DeviceID(std::stoi(strEID), networkID);
     }
-    catch (const std::exception& e)
+    // Endpoints not published yet may still come through InterfacesAdded.
+    // Those left when the hold time ends are reported by expireStaleService
+    size_t pending = stale.endpoints.size();
+    if (pending == 0)
     {
-        throw std::runtime_error(std::string("Error getting eid from ") +
-                                 objectPath.str + ". " + e.what());
+        stale.timer->cancel();
+        this->staleServices.erase(it);
     }
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        (wellKnownName + " returned. Adopted " + std::to_string(adopted) +
+         " endpoints, added " + std::to_string(events.size()) + ", " +
+         std::to_string(pending) + " still stale")
+            .c_str());
+    emitNetworkChangeEvents(std::move(events));
 }
 
-void MCTPImpl::listenForMCTPChanges()
+bool MCTPImpl::hasReceiveCallback() const
 {
-    static const std::string rule =
-        "type='signal',path='/xyz/openbmc_project/mctp'";
-
-    this->mctpChangesWatch = std::make_unique<sdbusplus::bus::match::match>(
-        *connection, rule,
-        std::bind(&MCTPImpl::onMCTPEvent, this, std::placeholders::_1));
+    return this->receiveCallback || this->extReceiveCallback ||
+           this->spanReceiveCallback;
+}
 
-    phosphor::logging::log<phosphor::logging::level::INFO>(
-        "Wrapper: Listening for all MCTP related signals");
+bool MCTPImpl::needsMessageReceivedMatch() const
+{
+    return hasReceiveCallback() || this->taggedRequestsUsed;
 }
 
-void MCTPImpl::onNewService(const std::string& serviceName)
+bool MCTPImpl::isMatchingVendorMessage(std::span<const uint8_t> payload) const
 {
-    phosphor::logging::log<phosphor::logging::level::INFO>(
-        (std::string("New service ") + serviceName).c_str());
-    matchedBuses.emplace(serviceName);
-    registerResponder(serviceName);
+    struct VendorHeader
+    {
+        uint8_t vdpciMessageType;
+        uint16_t vendorId;
+        uint16_t intelVendorMessageId;
+    } __attribute__((packed));
 
-    triggerGetOwnEID(serviceName);
+    if (!config.vendorId || !config.vendorMessageType ||
+        payload.size() < sizeof(VendorHeader))
+    {
+        return false;
+    }
+    VendorHeader vendorHdr;
+    std::memcpy(&vendorHdr, payload.data(), sizeof(vendorHdr));
+    return vendorHdr.vendorId == config.vendorId &&
+           (vendorHdr.intelVendorMessageId & config.vendorMessageType->mask) ==
+               (config.vendorMessageType->value &
+                config.vendorMessageType->mask);
 }
 
-void MCTPImpl::onNewEID(const std::string& serviceName, DeviceID extendedEID)
+void MCTPImpl::onMessageReceived(sdbusplus::message::message& msg)
 {
-    if (!this->networkChangeCallback)
+    if (!hasReceiveCallback() && this->pendingRequests.empty())
     {
         return;
     }
-    boost::asio::spawn(
-        connection->get_io_context(),
-        [this, extendedEID, serviceName](boost::asio::yield_context yield) {
-            this->endpointMap.emplace(extendedEID,
-                                      std::make_pair(0, serviceName));
-
-            mctpw::Event event;
-            event.eid = extendedEID.mctpEID();
-            event.deviceId = extendedEID;
-            event.type = mctpw::Event::EventType::deviceAdded;
-            this->networkChangeCallback(this, event, yield);
-        });
-}
 
-void MCTPImpl::onNewInterface(sdbusplus::message::message& msg)
-{
-    DictType<std::string, DictType<std::string, MctpPropertiesVariantType>>
-        values;
-    sdbusplus::message::object_path objectPath;
+    uint8_t messageType = 0;
+    uint8_t srcEid = 0;
+    uint8_t msgTag = 0;
+    bool tagOwner = false;
 
-    msg.read(objectPath, values);
-    phosphor::logging::log<phosphor::logging::level::DEBUG>(
-        (std::string("Interface added on ") + objectPath.str).c_str());
+    msg.read(messageType, srcEid, msgTag, tagOwner);
 
-    if (objectPath.str == "/xyz/openbmc_project/mctp")
+    if (static_cast<MessageType>(messageType) != config.type)
     {
-        // Interface added on base object. Means new service.
-        if (values.end() !=
-            values.find(
-                mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType)))
-        {
-            this->onNewService(msg.get_sender());
-        }
         return;
     }
 
-    if (!matchedBuses.contains(msg.get_sender()))
+    // Payload is used in place from the message buffer. It is copied only
+    // for the callbacks which take a ByteArray
+    const void* data = nullptr;
+    size_t size = 0;
+    int rc = sd_bus_message_read_array(msg.get(), 'y', &data, &size);
+    if (rc < 0)
     {
-        phosphor::logging::log<phosphor::logging::level::DEBUG>(
-            (std::string("Ignoring service not in interset: ") +
-             msg.get_sender())
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            (std::string("Error reading payload from ") + msg.get_sender() +
+             ". rc: " + std::to_string(rc))
                 .c_str());
         return;
     }
+    std::span<const uint8_t> payload(static_cast<const uint8_t*>(data),
+                                     size);
 
-    // TODO Check for /xyz/openbmc_project/mctp/\d+ using regex
-    if (objectPath.str.starts_with("/xyz/openbmc_project/mctp/"))
+    // Responses to requests sent with library managed tags are not passed to
+    // receive callbacks
+    if (!tagOwner && !this->pendingRequests.empty())
     {
-        // Interface added on base endpoint object. Means new EID
-        auto itSupportedMsgTypes =
-            values.find("xyz.openbmc_project.MCTP.SupportedMessageTypes");
-        if (values.end() != itSupportedMsgTypes)
+        if (auto nwid = getCachedNetworkID(msg.get_sender()))
         {
-            const auto& properties = itSupportedMsgTypes->second;
-            const auto& registeredMsgType = properties.at(
-                mctpw::MCTPImpl::msgTypeToPropertyName.at(config.type));
-            if (std::get<bool>(registeredMsgType))
+            if (completeTaggedRequest(DeviceID(srcEid, *nwid), msgTag,
+                                      boost::system::error_code(), payload))
             {
-                // TODO Check VDPCI mask matching
-                auto newExtendedEID =
-                    getDeviceIDFromPath(objectPath, msg.get_sender());
-                this->onNewEID(msg.get_sender(), newExtendedEID);
+                return;
             }
         }
     }
-}
+    if (!hasReceiveCallback())
+    {
+        return;
+    }
 
-void MCTPImpl::onEIDRemoved(DeviceID deviceID)
-{
-    if (eraseDevice(deviceID) == 0)
+    if (static_cast<MessageType>(messageType) == MessageType::vdpci &&
+        !isMatchingVendorMessage(payload))
     {
-        phosphor::logging::log<phosphor::logging::level::DEBUG>(
-            ("Removed device is not in endpoint map " +
-             std::to_string(deviceID.mctpEID()))
-                .c_str());
         return;
     }
-    if (!this->networkChangeCallback)
+    if (this->receiveCallback)
+    {
+        this->receiveCallback(this, srcEid, tagOwner, msgTag,
+                              ByteArray(payload.begin(), payload.end()), 0);
+    }
+    if (!this->extReceiveCallback && !this->spanReceiveCallback)
     {
         return;
     }
-    boost::asio::spawn(connection->get_io_context(),
-                       [this, deviceID](boost::asio::yield_context yield) {
-                           mctpw::Event event;
-                           event.type = mctpw::Event::EventType::deviceRemoved;
-                           event.eid = deviceID.mctpEID();
-                           event.deviceId = deviceID;
-                           this->networkChangeCallback(this, event, yield);
-                       });
-}
-
-void MCTPImpl::onInterfaceRemoved(sdbusplus::message::message& msg)
-{
-    sdbusplus::message::object_path objectPath;
-    std::vector<std::string> interfaces;
-    msg.read(objectPath, interfaces);
 
-    if (objectPath.str.starts_with("/xyz/openbmc_project/mctp/"))
+    std::string serviceName = msg.get_sender();
+    if (auto nwid = getCachedNetworkID(serviceName))
     {
-        if (std::find(interfaces.begin(), interfaces.end(),
-                      "xyz.openbmc_project.MCTP.SupportedMessageTypes") !=
-            interfaces.end())
+        DeviceID deviceId(srcEid, *nwid);
+        if (this->extReceiveCallback)
         {
-            try
-            {
-                auto deviceID =
-                    getDeviceIDFromPath(objectPath, msg.get_sender());
-                // Cannot check values of the interface since its removed
-                this->onEIDRemoved(deviceID);
-            }
-            catch (const std::exception& e)
-            {
-
-                phosphor::logging::log<phosphor::logging::level::INFO>(
-                    (std::string("Error in eid remove callback ") + e.what())
-                        .c_str());
-            }
+            this->extReceiveCallback(this, deviceId, tagOwner, msgTag,
+                                     ByteArray(payload.begin(), payload.end()),
+                                     0);
         }
-    }
-    else if (objectPath.str == "/xyz/openbmc_project/mctp")
-    {
-        if (std::find(interfaces.begin(), interfaces.end(),
-                      "xyz.openbmc_project.MCTP.Base") != interfaces.end())
+        if (this->spanReceiveCallback)
         {
-            phosphor::logging::log<phosphor::logging::level::INFO>(
-                ("Removing mctp service " + std::string(msg.get_sender()))
-                    .c_str());
-            this->matchedBuses.erase(msg.get_sender());
-            for (auto& [eid, service] : this->endpointMap)
-            {
-                if (service.second == msg.get_sender())
-                {
-                    phosphor::logging::log<phosphor::logging::level::ERR>(
-                        (std::string("EID entry invalid for : ") +
-                         msg.get_sender())
-                            .c_str());
-                }
-            }
+            this->spanReceiveCallback(this, deviceId, tagOwner, msgTag,
+                                      payload, 0);
         }
+        return;
     }
+    // Network id of this service is not known yet. Read it without
+    // blocking other users of the io_context and deliver afterwards. Message
+    // buffer is not valid by then, keep a copy
+    boost::asio::spawn(
+        connection->get_io_context(),
+        [this, serviceName, srcEid, tagOwner, msgTag,
+         buffer = retainPayload(payload)](boost::asio::yield_context yield) {
+            DeviceID deviceId(srcEid, getNetworkID(yield, serviceName));
+            if (this->extReceiveCallback)
+            {
+                this->extReceiveCallback(this, deviceId, tagOwner, msgTag,
+                                         *buffer, 0);
+            }
+            if (this->spanReceiveCallback)
+            {
+                this->spanReceiveCallback(this, deviceId, tagOwner, msgTag,
+                                          *buffer, 0);
+            }
+        });
 }
 
-void MCTPImpl::onMessageReceived(sdbusplus::message::message& msg)
+std::shared_ptr<ByteArray>
+    MCTPImpl::retainPayload(std::span<const uint8_t> payload)
 {
-    if (!this->receiveCallback && !this->extReceiveCallback)
-    {
-        return;
-    }
-
-    uint8_t messageType = 0;
-    uint8_t srcEid = 0;
-    uint8_t msgTag = 0;
-    bool tagOwner = false;
-    std::vector<uint8_t> payload;
+    return payloadPool->acquire(payload);
+}
 
-    msg.read(messageType, srcEid, msgTag, tagOwner, payload);
+void MCTPImpl::setBreakerStateCallback(BreakerStateCallback callback)
+{
+    this->breakerStateCallback = std::move(callback);
+}
 
-    if (static_cast<MessageType>(messageType) != config.type)
+void MCTPImpl::onBreakerStateChange(DeviceID devID, BreakerState state)
+{
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        "Circuit breaker state changed",
+        phosphor::logging::entry("EID=%d", devID.id),
+        phosphor::logging::entry("STATE=%d", static_cast<int>(state)));
+    if (!this->breakerStateCallback)
     {
         return;
     }
+    // Changes happen while requests are being scheduled. Report them from
+    // the event loop
+    boost::asio::post(connection->get_io_context(), [this, devID, state]() {
+        if (this->breakerStateCallback)
+        {
+            this->breakerStateCallback(this, devID, state);
+        }
+    });
+}
 
-    if (static_cast<MessageType>(messageType) == MessageType::vdpci)
+void MCTPImpl::setSpanReceiveCallback(ReceiveMessageSpanCallback callback)
+{
+    this->spanReceiveCallback = std::move(callback);
+    if (this->spanReceiveCallback)
     {
-        struct VendorHeader
+        for (auto& [serviceName, serviceMatch] : this->serviceMatches)
         {
-            uint8_t vdpciMessageType;
-            uint16_t vendorId;
-            uint16_t intelVendorMessageId;
-        } __attribute__((packed));
-        VendorHeader* vendorHdr =
-            reinterpret_cast<VendorHeader*>(payload.data());
+            addMessageReceivedMatch(serviceName, serviceMatch);
+        }
+    }
+}
 
-        if (!config.vendorId || !config.vendorMessageType ||
-            (vendorHdr->vendorId != config.vendorId) ||
-            ((vendorHdr->intelVendorMessageId &
-              config.vendorMessageType->mask) !=
-             (config.vendorMessageType->value &
-              config.vendorMessageType->mask)))
+namespace internal
+{
+std::shared_ptr<ByteArray>
+    PayloadPool::acquire(std::span<const uint8_t> payload)
+{
+    std::unique_ptr<ByteArray> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeBuffers.empty())
         {
-            return;
+            buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
         }
     }
-    if (this->receiveCallback)
+    if (!buffer)
     {
-        this->receiveCallback(this, srcEid, tagOwner, msgTag, payload, 0);
+        buffer = std::make_unique<ByteArray>();
     }
-    if (this->extReceiveCallback)
+    buffer->assign(payload.begin(), payload.end());
+    // Buffer goes back to the pool when the last user drops it, unless the
+    // pool is gone or full
+    return std::shared_ptr<ByteArray>(
+        buffer.release(),
+        [pool = std::weak_ptr<PayloadPool>(shared_from_this())](
+            ByteArray* released) {
+            std::unique_ptr<ByteArray> owned(released);
+            if (auto alive = pool.lock())
+            {
+                alive->release(std::move(owned));
+            }
+        });
+}
+
+void PayloadPool::release(std::unique_ptr<ByteArray> buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeBuffers.size() < maxFreeBuffers)
     {
-        auto nwid = getNetworkID(msg.get_sender());
-        this->extReceiveCallback(this, DeviceID(srcEid, nwid), tagOwner, msgTag,
-                                 payload, 0);
+        buffer->clear();
+        freeBuffers.emplace_back(std::move(buffer));
     }
 }
+} // namespace internal
 
 void MCTPImpl::onOwnEIDChange(std::string serviceName, eid_t eid)
 {
@@ -1119,10 +3781,16 @@ void MCTPImpl::onOwnEIDChange(std::string serviceName, eid_t eid)
 void MCTPImpl::onPropertiesChanged(sdbusplus::message::message& msg)
 {
     std::string intfName;
-    boost::container::flat_map<std::string, MctpPropertiesVariantType>
-        propertiesChanged;
+    PropertyMap propertiesChanged;
 
     msg.read(intfName, propertiesChanged);
+    if (intfName == "xyz.openbmc_project.MCTP.Base" ||
+        intfName ==
+            mctpw::MCTPWrapper::bindingToInterface.at(config.bindingType))
+    {
+        updateServiceProperties(msg.get_sender(), intfName,
+                                propertiesChanged);
+    }
     auto it = propertiesChanged.find("Eid");
 
     if (this->eidChangeCallback &&
@@ -1138,25 +3806,79 @@ void MCTPImpl::onPropertiesChanged(sdbusplus::message::message& msg)
 
 void MCTPImpl::onMCTPEvent(sdbusplus::message::message& msg)
 {
-    static const std::string intfAdded = "InterfacesAdded";
-    static const std::string intfRemoved = "InterfacesRemoved";
-    static const std::string msgReceived = "MessageReceivedSignal";
-    static const std::string propChanged = "PropertiesChanged";
-
     phosphor::logging::log<phosphor::logging::level::DEBUG>(
         (std::string("MCTP general event from ") + msg.get_sender()).c_str());
 
-    if (!this->isInitialisationsDone)
+    // Messages do not depend on the endpoint map. Endpoints of services
+    // scanned already may be in use during discovery
+    if (!this->isInitialisationsDone &&
+        std::string_view(msg.get_member()) != "MessageReceivedSignal")
     {
-        phosphor::logging::log<phosphor::logging::level::DEBUG>(
-            "Event will be dropped since endpoint discovery not done");
+        if (this->preDiscoveryEvents.size() < config.preDiscoveryEventLimit)
+        {
+            phosphor::logging::log<phosphor::logging::level::DEBUG>(
+                "Event will be replayed after endpoint discovery");
+            this->preDiscoveryEvents.emplace_back(std::move(msg));
+        }
+        else
+        {
+            phosphor::logging::log<phosphor::logging::level::DEBUG>(
+                "Event will be dropped since endpoint discovery not done");
+            this->preDiscoveryEventsDropped = true;
+        }
         return;
     }
+    dispatchMCTPEvent(msg);
+}
+
+void MCTPImpl::replayPreDiscoveryEvents()
+{
+    auto events = std::move(this->preDiscoveryEvents);
+    this->preDiscoveryEvents.clear();
+    if (!events.empty())
+    {
+        phosphor::logging::log<phosphor::logging::level::INFO>(
+            ("Replaying " + std::to_string(events.size()) +
+             " events received during endpoint discovery")
+                .c_str());
+    }
+    for (auto& msg : events)
+    {
+        try
+        {
+            dispatchMCTPEvent(msg, true);
+        }
+        catch (const std::exception& e)
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                (std::string("Replaying event failed. ") + e.what()).c_str());
+        }
+    }
+    if (this->preDiscoveryEventsDropped)
+    {
+        // Some changes are unknown. Compare against a full discovery instead
+        this->preDiscoveryEventsDropped = false;
+        phosphor::logging::log<phosphor::logging::level::WARNING>(
+            "Events were dropped during endpoint discovery. Rescanning");
+        boost::asio::spawn(connection->get_io_context(),
+                           [this](boost::asio::yield_context yield) {
+                               reconcileEndpointMap(yield);
+                           });
+    }
+}
+
+void MCTPImpl::dispatchMCTPEvent(sdbusplus::message::message& msg,
+                                 bool replayed)
+{
+    static const std::string intfAdded = "InterfacesAdded";
+    static const std::string intfRemoved = "InterfacesRemoved";
+    static const std::string msgReceived = "MessageReceivedSignal";
+    static const std::string propChanged = "PropertiesChanged";
 
     auto member = msg.get_member();
     if (member == intfAdded)
     {
-        this->onNewInterface(msg);
+        this->onNewInterface(msg, replayed);
     }
 
     if (!matchedBuses.contains(msg.get_sender()))
@@ -1192,6 +3914,14 @@ void MCTPImpl::setExtendedReceiveCallback(
         return;
     }
     this->extReceiveCallback = std::move(callback);
+    if (this->extReceiveCallback)
+    {
+        // Services found so far were registered without message matches
+        for (auto& [serviceName, serviceMatch] : this->serviceMatches)
+        {
+            addMessageReceivedMatch(serviceName, serviceMatch);
+        }
+    }
 }
 
 MCTPImpl::MCTPImpl(boost::asio::io_context& ioContext,
@@ -1200,8 +3930,15 @@ MCTPImpl::MCTPImpl(boost::asio::io_context& ioContext,
                    const ReceiveMessageCallback& rxCb) :
     connection(std::make_shared<sdbusplus::asio::connection>(ioContext)),
     config(configIn), networkChangeCallback(networkChangeCb),
-    receiveCallback(rxCb)
+    receiveCallback(rxCb), circuitBreakers(configIn),
+    payloadPool(std::make_shared<internal::PayloadPool>()),
+    scheduler(configIn), responseCache(configIn), rttEstimator(configIn),
+    flapDetector(configIn)
 {
+    circuitBreakers.stateChangeCallback = [this](DeviceID devID,
+                                                 BreakerState state) {
+        onBreakerStateChange(devID, state);
+    };
 }
 
 MCTPImpl::MCTPImpl(std::shared_ptr<sdbusplus::asio::connection> conn,
@@ -1211,8 +3948,27 @@ MCTPImpl::MCTPImpl(std::shared_ptr<sdbusplus::asio::connection> conn,
                    const ReceiveMessageCallback& rxCb) :
     connection(conn),
     config(configIn), networkChangeCallback(networkChangeCb),
-    receiveCallback(rxCb)
+    receiveCallback(rxCb), circuitBreakers(configIn),
+    payloadPool(std::make_shared<internal::PayloadPool>()),
+    scheduler(configIn), responseCache(configIn), rttEstimator(configIn),
+    flapDetector(configIn)
+{
+    circuitBreakers.stateChangeCallback = [this](DeviceID devID,
+                                                 BreakerState state) {
+        onBreakerStateChange(devID, state);
+    };
+}
+
+MCTPImpl::~MCTPImpl()
 {
+    // Handles may outlive the wrapper. Make sure they do not reach back
+    for (auto& [deviceId, weakEndpoint] : resolvedEndpoints)
+    {
+        if (auto endpoint = weakEndpoint.lock())
+        {
+            endpoint->impl = nullptr;
+        }
+    }
 }
 
 } // namespace mctpw
@@ -15,19 +15,32 @@
 */
 #pragma once
 
+#include "circuit_breaker.hpp"
+#include "endpoint_table.hpp"
+#include "flap_detector.hpp"
+#include "request_scheduler.hpp"
+#include "response_cache.hpp"
+#include "rtt_estimator.hpp"
 #include "mctp_wrapper.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/asio/spawn.hpp>
+#include <boost/container/flat_map.hpp>
 #include <chrono>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <optional>
 #include <sdbusplus/asio/connection.hpp>
 #include <sdbusplus/bus/match.hpp>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <variant>
 #include <vector>
 
 namespace mctpw
@@ -35,10 +48,45 @@ namespace mctpw
 /// MCTP Endpoint Id
 using ByteArray = std::vector<uint8_t>;
 
+template <typename T1, typename T2>
+using DictType = boost::container::flat_map<T1, T2>;
+using MctpPropertiesVariantType =
+    std::variant<uint16_t, int16_t, int32_t, uint32_t, bool, std::string,
+                 uint8_t, std::vector<uint8_t>, std::vector<uint16_t>>;
+/* Property map of a single object: DICT<property, VARIANT> */
+using PropertyMap = DictType<std::string, MctpPropertiesVariantType>;
+/* Interfaces of a single object: DICT<interface, DICT<property, VARIANT>> */
+using InterfaceMap = DictType<std::string, PropertyMap>;
+
+class MCTPImpl;
+
 namespace internal
 {
 struct NewServiceCallback;
 struct DeleteServiceCallback;
+
+/* Endpoint resolved to the dbus name of its mctp service. Shared by
+ * EndpointHandle objects. impl is cleared when the endpoint goes away */
+struct ResolvedEndpoint
+{
+    MCTPImpl* impl = nullptr;
+    DeviceID deviceId{};
+    std::string service;
+};
+
+/* Reusable buffers for payloads kept beyond the receive callback */
+class PayloadPool : public std::enable_shared_from_this<PayloadPool>
+{
+  public:
+    std::shared_ptr<ByteArray> acquire(std::span<const uint8_t> payload);
+
+  private:
+    static constexpr size_t maxFreeBuffers = 16;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ByteArray>> freeBuffers;
+
+    void release(std::unique_ptr<ByteArray> buffer);
+};
 } // namespace internal
 
 /**
@@ -76,9 +124,11 @@ class MCTPImpl
              const MCTPConfiguration& configIn,
              const ReconfigurationCallback& networkChangeCb,
              const ReceiveMessageCallback& rxCb);
+    ~MCTPImpl();
 
     using StatusCallback =
         std::function<void(boost::system::error_code, void*)>;
+    using DiscoveryBatchCallback = MCTPWrapper::DiscoveryBatchCallback;
 
     /* Endpoint map entry: DeviceID,pair(bus,service) */
     using EndpointMapExtended = MCTPWrapper::EndpointMapExtended;
@@ -94,6 +144,10 @@ class MCTPImpl
     /// Callback to be executed when a MCTP message received
     ReceiveMessageCallback receiveCallback = nullptr;
     ExtendedReceiveMessageCallback extReceiveCallback = nullptr;
+    ReceiveMessageSpanCallback spanReceiveCallback = nullptr;
+    BreakerStateCallback breakerStateCallback = nullptr;
+    BatchReconfigurationCallback batchNetworkChangeCallback = nullptr;
+    internal::CircuitBreakers circuitBreakers;
     OwnEIDChangeCallback eidChangeCallback;
 
     static const inline std::unordered_map<MessageType, const std::string>
@@ -114,18 +168,24 @@ class MCTPImpl
      *
      * @param callback Callback to be invoked after mctp endpoint detection with
      * status of the operation
+     * @param batchCallback Optional callback to be invoked with endpoints of
+     * each service as soon as the service is scanned
      */
-    void detectMctpEndpointsAsync(StatusCallback&& callbackc);
+    void detectMctpEndpointsAsync(StatusCallback&& callbackc,
+                                  DiscoveryBatchCallback batchCallback = nullptr);
     /**
      * @brief This method or its async variant must be called before accessing
      * any send receive functions. It scan and detect all mctp endpoints exposed
      * on dbus.
      *
      * @param yield boost yield_context object to yield on dbus calls
+     * @param batchCallback Optional callback to be invoked with endpoints of
+     * each service as soon as the service is scanned
      * @return boost::system::error_code
      */
     boost::system::error_code
-        detectMctpEndpoints(boost::asio::yield_context yield);
+        detectMctpEndpoints(boost::asio::yield_context yield,
+                            DiscoveryBatchCallback batchCallback = nullptr);
     /**
      * @brief Get a reference to internaly maintained EndpointMap
      *
@@ -133,7 +193,7 @@ class MCTPImpl
      */
     inline const EndpointMapExtended& getEndpointMap() const
     {
-        return this->endpointMap;
+        return this->endpointTable.view();
     }
 
     /**
@@ -174,7 +234,19 @@ class MCTPImpl
      */
     void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
                           const ByteArray& request,
-                          std::chrono::milliseconds timeout);
+                          std::chrono::milliseconds timeout,
+                          Priority priority = Priority::normal,
+                          const RetryPolicy* policy = nullptr);
+    void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          ByteSpanList request,
+                          std::chrono::milliseconds timeout,
+                          Priority priority = Priority::normal,
+                          const RetryPolicy* policy = nullptr);
+    void sendReceiveAsync(ReceiveCallback receiveCb,
+                          const internal::ResolvedEndpoint& endpoint,
+                          const ByteArray& request,
+                          std::chrono::milliseconds timeout,
+                          Priority priority = Priority::normal);
 
     /**
      * @brief Send request to dstEId and receive response using yield_context
@@ -189,7 +261,21 @@ class MCTPImpl
     std::pair<boost::system::error_code, ByteArray>
         sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
                          const ByteArray& request,
-                         std::chrono::milliseconds timeout);
+                         std::chrono::milliseconds timeout,
+                         Priority priority = Priority::normal,
+                         const RetryPolicy* policy = nullptr);
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                         ByteSpanList request,
+                         std::chrono::milliseconds timeout,
+                         Priority priority = Priority::normal,
+                         const RetryPolicy* policy = nullptr);
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveYield(boost::asio::yield_context yield,
+                         const internal::ResolvedEndpoint& endpoint,
+                         const ByteArray& request,
+                         std::chrono::milliseconds timeout,
+                         Priority priority = Priority::normal);
     /**
      * @brief Send request to dstEId and receive response using blocked
      * calls     *
@@ -203,6 +289,9 @@ class MCTPImpl
     std::pair<boost::system::error_code, ByteArray>
         sendReceiveBlocked(DeviceID devID, const ByteArray& request,
                            std::chrono::milliseconds timeout);
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveBlocked(DeviceID devID, ByteSpanList request,
+                           std::chrono::milliseconds timeout);
 
     /**
      * @brief Register a responder application with MCTP layer
@@ -235,6 +324,13 @@ class MCTPImpl
     void sendAsync(const SendCallback& callback, const DeviceID devID,
                    const uint8_t msgTag, const bool tagOwner,
                    const ByteArray& request);
+    void sendAsync(const SendCallback& callback, const DeviceID devID,
+                   const uint8_t msgTag, const bool tagOwner,
+                   ByteSpanList request);
+    void sendAsync(const SendCallback& callback,
+                   const internal::ResolvedEndpoint& endpoint,
+                   const uint8_t msgTag, const bool tagOwner,
+                   const ByteArray& request);
 
     /**
      * @brief Send MCTP request to dstEId and receive status of send operation
@@ -252,20 +348,264 @@ class MCTPImpl
         sendYield(boost::asio::yield_context& yield, const DeviceID devID,
                   const uint8_t msgTag, const bool tagOwner,
                   const ByteArray& request);
+    std::pair<boost::system::error_code, int>
+        sendYield(boost::asio::yield_context& yield, const DeviceID devID,
+                  const uint8_t msgTag, const bool tagOwner,
+                  ByteSpanList request);
+    std::pair<boost::system::error_code, int>
+        sendYield(boost::asio::yield_context& yield,
+                  const internal::ResolvedEndpoint& endpoint,
+                  const uint8_t msgTag, const bool tagOwner,
+                  const ByteArray& request);
+
+    /**
+     * @brief Send request to devID with a message tag allocated by the
+     * library and receive the matching response asynchronously in receiveCb.
+     * Response is matched from MessageReceivedSignal, so the dbus method call
+     * completes as soon as the request is sent.
+     *
+     * @param receiveCb Callback to be executed when response is ready.
+     * Invoked with timed_out if response is not received within timeout and
+     * with resource_unavailable_try_again if all tags of devID are in use
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout Time to wait for response
+     */
+    void sendRequestAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          ByteSpanList request,
+                          std::chrono::milliseconds timeout);
+    std::pair<boost::system::error_code, ByteArray>
+        sendRequestYield(boost::asio::yield_context yield, DeviceID devID,
+                         ByteSpanList request,
+                         std::chrono::milliseconds timeout);
+
+    using SendReceiveManyResultCallback =
+        MCTPWrapper::SendReceiveManyResultCallback;
+    using SendReceiveManyCompleteCallback =
+        MCTPWrapper::SendReceiveManyCompleteCallback;
+    /**
+     * @brief Send a request to each target and receive responses
+     * asynchronously
+     *
+     * @param targets Destination and request of each request
+     * @param options Concurrency limit, timeouts and priority
+     * @param resultCb Callback invoked as each request completes
+     * @param completeCb Callback invoked with all results
+     */
+    void sendReceiveManyAsync(std::span<const SendReceiveTarget> targets,
+                              const SendReceiveManyOptions& options,
+                              SendReceiveManyResultCallback resultCb,
+                              SendReceiveManyCompleteCallback completeCb);
+    void sendReceiveManyAsync(std::span<const DeviceID> devIDs,
+                              ByteSpan request,
+                              const SendReceiveManyOptions& options,
+                              SendReceiveManyResultCallback resultCb,
+                              SendReceiveManyCompleteCallback completeCb);
+    /**
+     * @brief Send a request to each target and wait for all responses using
+     * yield_context
+     *
+     * @param yield Boost yield_context to use
+     * @param targets Destination and request of each request
+     * @param options Concurrency limit, timeouts and priority
+     * @param resultCb Callback invoked as each request completes
+     * @return std::vector<SendReceiveResult> Results in the order of targets
+     */
+    std::vector<SendReceiveResult>
+        sendReceiveMany(boost::asio::yield_context yield,
+                        std::span<const SendReceiveTarget> targets,
+                        const SendReceiveManyOptions& options,
+                        SendReceiveManyResultCallback resultCb);
+    std::vector<SendReceiveResult>
+        sendReceiveMany(boost::asio::yield_context yield,
+                        std::span<const DeviceID> devIDs, ByteSpan request,
+                        const SendReceiveManyOptions& options,
+                        SendReceiveManyResultCallback resultCb);
+
+    /**
+     * @brief Resolve DeviceID to its service once for repeated use
+     *
+     * @param devID MCTP Device ID
+     * @return Shared resolved state or nullptr if DeviceID is not known. The
+     * same object is returned while any handle holds it
+     */
+    std::shared_ptr<internal::ResolvedEndpoint>
+        resolveEndpoint(DeviceID devID);
     void addToEidMap(boost::asio::yield_context yield,
                      const std::string& serviceName/*, uint16_t vid,
                      uint16_t vmsgType*/);
     size_t eraseDevice(DeviceID eid);
     std::optional<std::string> getDeviceLocation(const DeviceID eid);
+    std::optional<std::string> getDeviceLocation(boost::asio::yield_context yield,
+                                                 const DeviceID eid);
     void getOwnEIDs(OwnEIDChangeCallback callback);
     void setExtendedReceiveCallback(ExtendedReceiveMessageCallback callback);
+    void setSpanReceiveCallback(ReceiveMessageSpanCallback callback);
+    void setBreakerStateCallback(BreakerStateCallback callback);
+    void setBatchReconfigurationCallback(BatchReconfigurationCallback callback);
+    BreakerState getBreakerState(DeviceID devID) const
+    {
+        return circuitBreakers.state(devID);
+    }
+    FlapStatistics getFlapStatistics(DeviceID devID) const
+    {
+        return flapDetector.statistics(devID);
+    }
+    std::shared_ptr<ByteArray> retainPayload(std::span<const uint8_t> payload);
 
   private:
-    EndpointMapExtended endpointMap;
+    internal::EndpointTable endpointTable;
     std::unordered_set<std::string> matchedBuses;
     std::vector<VersionFields> responderVersions;
     std::unordered_map<std::string, uint8_t> networkIDCache;
+    /* Properties of /xyz/openbmc_project/mctp on each service, by interface.
+     * Fetched once per interface using GetAll and updated from
+     * PropertiesChanged signals */
+    std::unordered_map<std::string, InterfaceMap> servicePropertiesCache;
+    /* Well known service name to unique connection name */
+    std::unordered_map<std::string, std::string> uniqueNames;
+    /* Well known names of services matched so far. Checked when a service
+     * comes back under a new unique name */
+    std::unordered_set<std::string> wellKnownNames;
+    /* I3C services have no bus property. They are numbered in the order they
+     * are first seen */
+    std::unordered_map<std::string, int> i3cBusIds;
+    int getI3CBusId(const std::string& serviceName)
+    {
+        return this->i3cBusIds
+            .try_emplace(serviceName, static_cast<int>(this->i3cBusIds.size()))
+            .first->second;
+    }
+    /* Unique name of service if known. Same mctpd under either name maps to
+     * one key */
+    const std::string& canonicalServiceName(const std::string& service) const
+    {
+        auto it = this->uniqueNames.find(service);
+        return it != this->uniqueNames.end() ? it->second : service;
+    }
+    /* Endpoints handed out through EndpointHandle objects */
+    std::unordered_map<DeviceID, std::weak_ptr<internal::ResolvedEndpoint>>
+        resolvedEndpoints;
     bool isInitialisationsDone = false;
+    std::shared_ptr<internal::PayloadPool> payloadPool;
+
+    // Requests sent with library managed message tags
+    static constexpr uint8_t maxMessageTags = 8;
+    // Message type, PLDM header and command
+    static constexpr size_t requestHeaderSize = 4;
+    struct PendingRequest
+    {
+        uint64_t id = 0;
+        ReceiveCallback callback;
+        std::unique_ptr<boost::asio::steady_timer> timer;
+        std::chrono::milliseconds timeout{};
+        // Leading request bytes. A response must match them. See
+        // isResponseTo
+        ByteArray header;
+    };
+    /* Bit mask of tags in use per DeviceID */
+    std::unordered_map<DeviceID, uint8_t> tagsInUse;
+    /* Key: DeviceID and message tag. See pendingKey */
+    std::unordered_map<uint32_t, PendingRequest> pendingRequests;
+    uint64_t lastRequestId = 0;
+    bool taggedRequestsUsed = false;
+
+    // sendReceive requests are scheduled per DeviceID and per service
+    using ScheduledRequest = internal::RequestScheduler::Request;
+    internal::RequestScheduler scheduler;
+    internal::ResponseCache responseCache;
+    internal::RttEstimator rttEstimator;
+
+    // Serve request from response cache or send it as given by policy
+    void scheduleSendReceive(ReceiveCallback callback,
+                             const std::string& service, DeviceID devID,
+                             ByteSpanList request,
+                             std::chrono::milliseconds timeout,
+                             Priority priority, const RetryPolicy& policy);
+    // Send one attempt through the scheduler
+    // takeSample decides at completion if the round trip time is fed to
+    // rttEstimator. Always when empty
+    void submitSendReceive(ReceiveCallback callback, const std::string& service,
+                           DeviceID devID, ByteSpanList request,
+                           std::chrono::milliseconds timeout, Priority priority,
+                           bool coalescable,
+                           std::function<bool()> takeSample = nullptr);
+
+    // State of a request sent with retries. Defined in mctp_impl.cpp
+    struct RetryRequest;
+    std::minstd_rand retryRandom{std::random_device{}()};
+    void startAttempt(const std::shared_ptr<RetryRequest>& retry, bool hedge);
+    void onAttemptDone(const std::shared_ptr<RetryRequest>& retry,
+                       boost::system::error_code ec, ByteArray& response);
+    std::chrono::milliseconds backoff(const RetryPolicy& policy,
+                                      unsigned attempt);
+    void onBreakerStateChange(DeviceID devID, BreakerState state);
+    ReceiveCallback
+        scheduledCompletion(const std::shared_ptr<ScheduledRequest>& scheduled);
+    // Invoke callback of the request once and start waiting requests which
+    // may run now
+    void finishScheduledRequest(
+        const std::shared_ptr<ScheduledRequest>& scheduled,
+        boost::system::error_code ec, ByteArray& response);
+    // Identical sendReceive requests outstanding at once share one request
+    // when config.coalesceRequests is set
+    struct CoalescedRequest
+    {
+        DeviceID devID{};
+        ByteArray request;
+        std::vector<ReceiveCallback> callbacks;
+    };
+    /* Key: hash of DeviceID and request bytes */
+    std::unordered_multimap<size_t, std::shared_ptr<CoalescedRequest>>
+        coalescedRequests;
+    /**
+     * @brief Attach callback to an identical outstanding request
+     *
+     * @return Empty if callback was attached. Otherwise the callback to send
+     * the request with, which completes all attached callers
+     */
+    ReceiveCallback coalesce(ReceiveCallback callback, DeviceID devID,
+                             ByteSpanList request);
+
+    // State of one sendReceiveMany call. Defined in mctp_impl.cpp
+    struct ManyRequest;
+    void startManyRequest(const std::shared_ptr<ManyRequest>& many);
+    // Send waiting requests of the batch while the concurrency limit allows
+    void launchManyRequest(const std::shared_ptr<ManyRequest>& many);
+    void completeManyRequest(const std::shared_ptr<ManyRequest>& many,
+                             size_t index, boost::system::error_code ec,
+                             ByteArray& response);
+    void expireManyRequest(const std::shared_ptr<ManyRequest>& many);
+    std::vector<SendReceiveResult> awaitManyRequest(
+        boost::asio::yield_context yield,
+        const std::function<void(SendReceiveManyCompleteCallback)>& initiate);
+    // Run initiate with a callback which resumes the coroutine
+    std::pair<boost::system::error_code, ByteArray>
+        awaitResponse(boost::asio::yield_context yield,
+                      const std::function<void(ReceiveCallback)>& initiate);
+
+    static uint32_t pendingKey(DeviceID devID, uint8_t msgTag)
+    {
+        return (devID.id << 3) | (msgTag & 0x07);
+    }
+    std::optional<uint8_t> acquireTag(DeviceID devID);
+    void releaseTag(DeviceID devID, uint8_t msgTag);
+    // Keep tag of a timed out request in use for another timeout, so a late
+    // response cannot complete the next request using the tag
+    void quarantineTag(DeviceID devID, uint8_t msgTag,
+                       std::chrono::milliseconds timeout);
+    // Check response against the request header. Received messages with the
+    // same tag may belong to mctpd or to another process
+    static bool isResponseTo(std::span<const uint8_t> requestHeader,
+                             std::span<const uint8_t> response);
+    // Complete pending request with response or error. requestId guards
+    // against completing a newer request which reuses the same tag. Returns
+    // false if there is no matching request
+    bool completeTaggedRequest(DeviceID devID, uint8_t msgTag,
+                               boost::system::error_code ec,
+                               std::span<const uint8_t> payload,
+                               std::optional<uint64_t> requestId =
+                                   std::nullopt);
 
     // Get list of pair<bus, service_name_string> which expose mctp object
     std::optional<std::vector<std::pair<unsigned, std::string>>>
@@ -273,36 +613,169 @@ class MCTPImpl
     /* Return format: map<Eid, pair<bus, service_name_string>> */
     EndpointMapExtended buildMatchingEndpointMap(
         boost::asio::yield_context yield,
-        std::vector<std::pair<unsigned, std::string>>& buses);
+        std::vector<std::pair<unsigned, std::string>>& buses,
+        const std::function<void(const EndpointMapExtended&)>&
+            onServiceScanned = nullptr);
+    // Check SupportedMessageTypes and vendor defined properties of an endpoint
+    // object against config
+    bool isMatchingEndpoint(const sdbusplus::message::object_path& objectPath,
+                            const InterfaceMap& interfaces) const;
+    // Run task for every index in [0, count) using at most limit coroutines
+    // at a time. Returns once all the tasks are completed. 0 means no limit
+    void runConcurrently(
+        boost::asio::yield_context yield, size_t count, size_t limit,
+        const std::function<void(size_t, boost::asio::yield_context)>& task);
     // Get bus id from servicename. Example: Returns 2 if device path is
     // /dev/i2c-2
-    int getBusId(const std::string& serviceName);
+    int getBusId(boost::asio::yield_context yield,
+                 const std::string& serviceName);
 
     void listenForMCTPChanges();
     std::unique_ptr<sdbusplus::bus::match::match> mctpChangesWatch{};
     void onMCTPEvent(sdbusplus::message::message& msg);
-    void onNewInterface(sdbusplus::message::message& msg);
+    // Replayed events are checked against the endpoint map built by discovery
+    void dispatchMCTPEvent(sdbusplus::message::message& msg,
+                           bool replayed = false);
+    // Signals received before endpoint discovery completed
+    std::deque<sdbusplus::message::message> preDiscoveryEvents;
+    bool preDiscoveryEventsDropped = false;
+    void replayPreDiscoveryEvents();
+    void onNewInterface(sdbusplus::message::message& msg,
+                        bool replayed = false);
     void onInterfaceRemoved(sdbusplus::message::message& msg);
     void onMessageReceived(sdbusplus::message::message& msg);
+    bool hasReceiveCallback() const;
+    bool needsMessageReceivedMatch() const;
+    // Check VDPCI header of payload against vendor filter in config
+    bool isMatchingVendorMessage(std::span<const uint8_t> payload) const;
     void onPropertiesChanged(sdbusplus::message::message& msg);
     void onNewService(const std::string& serviceName);
-    void onNewEID(const std::string& serviceName, DeviceID eid);
+    void onNewEID(const std::string& serviceName, DeviceID eid,
+                  bool replayed = false);
     void onOwnEIDChange(std::string serviceName, eid_t eid);
     void onEIDRemoved(DeviceID eid);
+    void emitNetworkChangeEvent(Event::EventType type, DeviceID eid);
+    void emitNetworkChangeEvents(std::vector<Event> events);
+    void deliverNetworkChangeEvent(const Event& event);
+    // Events waiting for config.eventBatchWindow to elapse
+    std::vector<Event> batchedEvents;
+    std::unique_ptr<boost::asio::steady_timer> eventBatchTimer;
+    void batchNetworkChangeEvent(const Event& event);
+    void flushNetworkChangeEvents();
+    // Events of quarantined endpoints are held back until they settle
+    internal::FlapDetector flapDetector;
+    std::unique_ptr<boost::asio::steady_timer> flapReleaseTimer;
+    bool isFlapping(const Event& event);
+    void scheduleFlapRelease();
+    // Deliver events which passed flap detection
+    void postNetworkChangeEvents(std::vector<Event> events);
+    void onNameOwnerChanged(sdbusplus::message::message& msg);
+    // Service left the bus or removed its Base interface. Evict its
+    // endpoints and abort requests sent to it
+    void onServiceLost(const std::string& serviceName);
+
+    // Endpoints of a service which left the bus, kept for
+    // config.staleHoldTime. Keyed by well known name since the unique name
+    // changes on restart
+    struct StaleService
+    {
+        std::string uniqueName;
+        EndpointMapExtended endpoints;
+        std::unique_ptr<boost::asio::steady_timer> timer;
+    };
+    std::unordered_map<std::string, StaleService> staleServices;
+    void holdStaleEndpoints(const std::string& wellKnownName,
+                            const std::string& uniqueName,
+                            EndpointMapExtended endpoints);
+    void expireStaleService(const std::string& wellKnownName);
+    // Report a returning endpoint as unchanged. Returns true if it was stale
+    bool takeStaleEndpoint(DeviceID devID);
+    // Map well known name of a returning service to its new unique name and
+    // reconcile its stale endpoints if any
+    void mapReturningService(boost::asio::yield_context yield,
+                             const std::string& uniqueName);
+    // Diff endpoints of a restarted service against its stale endpoints
+    void reconcileStaleService(boost::asio::yield_context yield,
+                               const std::string& wellKnownName);
+    void invalidateResolvedEndpoint(DeviceID eid);
+    // Invalidate resolved endpoints which are no longer in endpoint table
+    void pruneResolvedEndpoints();
+
+    // Send paths shared by DeviceID and resolved endpoint variants
+    void doSendReceiveAsync(ReceiveCallback callback,
+                            const std::string& service, DeviceID devID,
+                            ByteSpanList request,
+                            std::chrono::milliseconds timeout,
+                            std::function<bool()> takeSample = nullptr);
+    void doSendAsync(const SendCallback& callback, const std::string& service,
+                     const DeviceID devID, const uint8_t msgTag,
+                     const bool tagOwner, ByteSpanList request);
+    std::pair<boost::system::error_code, int>
+        doSendYield(boost::asio::yield_context& yield,
+                    const std::string& service, const DeviceID devID,
+                    const uint8_t msgTag, const bool tagOwner,
+                    ByteSpanList request);
+    // Build method calls with payload parts copied directly into the message.
+    // Throw boost::system::system_error if payload can not be appended
+    sdbusplus::message::message
+        newSendReceiveCall(const std::string& service, DeviceID devID,
+                           ByteSpanList request,
+                           std::chrono::milliseconds timeout);
+    sdbusplus::message::message newSendCall(const std::string& service,
+                                            DeviceID devID,
+                                            const uint8_t msgTag,
+                                            const bool tagOwner,
+                                            ByteSpanList request);
+
+    // Populate endpoint map from snapshot file. Returns false if snapshot is
+    // not available or none of the services in it is still alive
+    bool loadEndpointSnapshot(boost::asio::yield_context yield);
+    void saveEndpointSnapshot();
+    // Run full discovery and apply the difference to current endpoint map
+    void reconcileEndpointMap(boost::asio::yield_context yield);
     void addUniqueNameToMatchedServices(const std::string& serviceName,
                                         boost::asio::yield_context yield);
 
+    // Returns properties of an interface of mctp base object on the service.
+    // Fetched using a single GetAll on first access. nullptr if properties
+    // are not available
+    const PropertyMap* getServiceProperties(boost::asio::yield_context yield,
+                                            const std::string& serviceName,
+                                            const std::string& interface);
+    const PropertyMap*
+        getCachedServiceProperties(const std::string& serviceName,
+                                   const std::string& interface) const;
+    void updateServiceProperties(const std::string& sender,
+                                 const std::string& interface,
+                                 const PropertyMap& changedProperties);
+    void eraseServiceProperties(const std::string& sender);
+
+    // Signal matches of a single service. Installed when the service is
+    // matched so that dbus-daemon filters out signals of other services
+    struct ServiceMatches
+    {
+        std::vector<std::unique_ptr<sdbusplus::bus::match::match>> matches;
+        // Only needed if there is a receive callback
+        std::unique_ptr<sdbusplus::bus::match::match> messageReceived;
+    };
+    std::unordered_map<std::string, ServiceMatches> serviceMatches;
     void registerListeners(const std::string& serviceName);
     void unRegisterListeners(const std::string& serviceName);
+    void addMessageReceivedMatch(const std::string& serviceName,
+                                 ServiceMatches& serviceMatch);
 
     void triggerGetOwnEID(const std::string& serviceName);
     boost::system::error_code registerResponder(const std::string& serviceName);
     friend struct internal::NewServiceCallback;
     friend struct internal::DeleteServiceCallback;
 
-    uint8_t getNetworkID(const std::string& serviceName);
+    NetworkID getNetworkID(boost::asio::yield_context yield,
+                           const std::string& serviceName);
+    std::optional<NetworkID>
+        getCachedNetworkID(const std::string& serviceName) const;
     DeviceID
-        getDeviceIDFromPath(const sdbusplus::message::object_path& objectPath,
+        getDeviceIDFromPath(boost::asio::yield_context yield,
+                            const sdbusplus::message::object_path& objectPath,
                             const std::string& serviceName);
 };
 } // namespace mctpw
@@ -28,12 +28,6 @@
 
 using namespace mctpw;
 
-template <typename T1, typename T2>
-using DictType = boost::container::flat_map<T1, T2>;
-using MctpPropertiesVariantType =
-    std::variant<uint16_t, int16_t, int32_t, uint32_t, bool, std::string,
-                 uint8_t, std::vector<uint8_t>>;
-
 MCTPConfiguration::MCTPConfiguration(MessageType msgType, BindingType binding) :
     type(msgType), bindingType(binding)
 {
@@ -85,6 +79,13 @@ void MCTPWrapper::detectMctpEndpointsAsync(StatusCallback&& registerCB)
     pimpl->detectMctpEndpointsAsync(std::forward<StatusCallback>(registerCB));
 }
 
+void MCTPWrapper::detectMctpEndpointsAsync(StatusCallback&& registerCB,
+                                           DiscoveryBatchCallback batchCB)
+{
+    pimpl->detectMctpEndpointsAsync(std::forward<StatusCallback>(registerCB),
+                                    std::move(batchCB));
+}
+
 boost::system::error_code
     MCTPWrapper::detectMctpEndpoints(boost::asio::yield_context yield)
 {
@@ -95,6 +96,13 @@ boost::system::error_code
     return ec;
 }
 
+boost::system::error_code
+    MCTPWrapper::detectMctpEndpoints(boost::asio::yield_context yield,
+                                     DiscoveryBatchCallback batchCB)
+{
+    return pimpl->detectMctpEndpoints(yield, std::move(batchCB));
+}
+
 void MCTPWrapper::sendReceiveAsync(ReceiveCallback callback, eid_t dstEId,
                                    const ByteArray& request,
                                    std::chrono::milliseconds timeout)
@@ -109,6 +117,23 @@ void MCTPWrapper::sendReceiveAsync(ReceiveCallback callback, DeviceID extendedEI
     pimpl->sendReceiveAsync(callback, extendedEID, request, timeout);
 }
 
+void MCTPWrapper::sendReceiveAsync(ReceiveCallback callback, DeviceID extendedEID,
+                                   const ByteArray& request,
+                                   std::chrono::milliseconds timeout,
+                                   Priority priority)
+{
+    pimpl->sendReceiveAsync(callback, extendedEID, request, timeout, priority);
+}
+
+void MCTPWrapper::sendReceiveAsync(ReceiveCallback callback, DeviceID extendedEID,
+                                   const ByteArray& request,
+                                   std::chrono::milliseconds timeout,
+                                   const RetryPolicy& policy, Priority priority)
+{
+    pimpl->sendReceiveAsync(callback, extendedEID, request, timeout, priority,
+                            &policy);
+}
+
 std::pair<boost::system::error_code, ByteArray>
     MCTPWrapper::sendReceiveYield(boost::asio::yield_context yield,
                                   eid_t dstEId, const ByteArray& request,
@@ -125,6 +150,26 @@ std::pair<boost::system::error_code, ByteArray>
     return pimpl->sendReceiveYield(yield, extendedEID, request, timeout);
 }
 
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendReceiveYield(boost::asio::yield_context yield,
+                                  DeviceID extendedEID, const ByteArray& request,
+                                  std::chrono::milliseconds timeout,
+                                  Priority priority)
+{
+    return pimpl->sendReceiveYield(yield, extendedEID, request, timeout,
+                                   priority);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendReceiveYield(boost::asio::yield_context yield,
+                                  DeviceID extendedEID, const ByteArray& request,
+                                  std::chrono::milliseconds timeout,
+                                  const RetryPolicy& policy, Priority priority)
+{
+    return pimpl->sendReceiveYield(yield, extendedEID, request, timeout,
+                                   priority, &policy);
+}
+
 std::pair<boost::system::error_code, ByteArray>
     MCTPWrapper::sendReceiveBlocked(eid_t dstEId, const ByteArray& request,
                                     std::chrono::milliseconds timeout)
@@ -180,6 +225,139 @@ std::pair<boost::system::error_code, int>
     return pimpl->sendYield(yield, extendedEID, msgTag, tagOwner, request);
 }
 
+void MCTPWrapper::sendReceiveAsync(ReceiveCallback callback,
+                                   DeviceID extendedEID, ByteSpan request,
+                                   std::chrono::milliseconds timeout)
+{
+    pimpl->sendReceiveAsync(callback, extendedEID, ByteSpanList(&request, 1),
+                            timeout);
+}
+
+void MCTPWrapper::sendReceiveAsync(ReceiveCallback callback,
+                                   DeviceID extendedEID, ByteSpanList request,
+                                   std::chrono::milliseconds timeout)
+{
+    pimpl->sendReceiveAsync(callback, extendedEID, request, timeout);
+}
+
+void MCTPWrapper::sendReceiveAsync(ReceiveCallback callback,
+                                   DeviceID extendedEID, ByteSpanList request,
+                                   std::chrono::milliseconds timeout,
+                                   Priority priority)
+{
+    pimpl->sendReceiveAsync(callback, extendedEID, request, timeout, priority);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendReceiveYield(boost::asio::yield_context yield,
+                                  DeviceID extendedEID, ByteSpan request,
+                                  std::chrono::milliseconds timeout)
+{
+    return pimpl->sendReceiveYield(yield, extendedEID,
+                                   ByteSpanList(&request, 1), timeout);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendReceiveYield(boost::asio::yield_context yield,
+                                  DeviceID extendedEID, ByteSpanList request,
+                                  std::chrono::milliseconds timeout)
+{
+    return pimpl->sendReceiveYield(yield, extendedEID, request, timeout);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendReceiveYield(boost::asio::yield_context yield,
+                                  DeviceID extendedEID, ByteSpanList request,
+                                  std::chrono::milliseconds timeout,
+                                  Priority priority)
+{
+    return pimpl->sendReceiveYield(yield, extendedEID, request, timeout,
+                                   priority);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendReceiveBlocked(DeviceID extendedEID, ByteSpan request,
+                                    std::chrono::milliseconds timeout)
+{
+    return pimpl->sendReceiveBlocked(extendedEID, ByteSpanList(&request, 1),
+                                     timeout);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendReceiveBlocked(DeviceID extendedEID, ByteSpanList request,
+                                    std::chrono::milliseconds timeout)
+{
+    return pimpl->sendReceiveBlocked(extendedEID, request, timeout);
+}
+
+void MCTPWrapper::sendAsync(const SendCallback& callback,
+                            const DeviceID extendedEID, const uint8_t msgTag,
+                            const bool tagOwner, ByteSpan request)
+{
+    pimpl->sendAsync(callback, extendedEID, msgTag, tagOwner,
+                     ByteSpanList(&request, 1));
+}
+
+void MCTPWrapper::sendAsync(const SendCallback& callback,
+                            const DeviceID extendedEID, const uint8_t msgTag,
+                            const bool tagOwner, ByteSpanList request)
+{
+    pimpl->sendAsync(callback, extendedEID, msgTag, tagOwner, request);
+}
+
+std::pair<boost::system::error_code, int>
+    MCTPWrapper::sendYield(boost::asio::yield_context& yield,
+                           const DeviceID extendedEID, const uint8_t msgTag,
+                           const bool tagOwner, ByteSpan request)
+{
+    return pimpl->sendYield(yield, extendedEID, msgTag, tagOwner,
+                            ByteSpanList(&request, 1));
+}
+
+std::pair<boost::system::error_code, int>
+    MCTPWrapper::sendYield(boost::asio::yield_context& yield,
+                           const DeviceID extendedEID, const uint8_t msgTag,
+                           const bool tagOwner, ByteSpanList request)
+{
+    return pimpl->sendYield(yield, extendedEID, msgTag, tagOwner, request);
+}
+
+void MCTPWrapper::sendRequestAsync(ReceiveCallback callback,
+                                   DeviceID extendedEID,
+                                   const ByteArray& request,
+                                   std::chrono::milliseconds timeout)
+{
+    ByteSpan part(request);
+    pimpl->sendRequestAsync(callback, extendedEID, ByteSpanList(&part, 1),
+                            timeout);
+}
+
+void MCTPWrapper::sendRequestAsync(ReceiveCallback callback,
+                                   DeviceID extendedEID, ByteSpanList request,
+                                   std::chrono::milliseconds timeout)
+{
+    pimpl->sendRequestAsync(callback, extendedEID, request, timeout);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendRequestYield(boost::asio::yield_context yield,
+                                  DeviceID extendedEID,
+                                  const ByteArray& request,
+                                  std::chrono::milliseconds timeout)
+{
+    ByteSpan part(request);
+    return pimpl->sendRequestYield(yield, extendedEID, ByteSpanList(&part, 1),
+                                   timeout);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::sendRequestYield(boost::asio::yield_context yield,
+                                  DeviceID extendedEID, ByteSpanList request,
+                                  std::chrono::milliseconds timeout)
+{
+    return pimpl->sendRequestYield(yield, extendedEID, request, timeout);
+}
+
 const MCTPWrapper::EndpointMap& MCTPWrapper::getEndpointMap()
 {
     auto& extendedMap = pimpl->getEndpointMap();
@@ -230,6 +408,111 @@ int MCTPWrapper::releaseBandwidth(boost::asio::yield_context yield,
     return pimpl->releaseBandwidth(yield, extendedEID);
 }
 
+MCTPWrapper::EndpointHandle
+    MCTPWrapper::getEndpointHandle(const DeviceID extendedEID)
+{
+    return EndpointHandle(pimpl->resolveEndpoint(extendedEID));
+}
+
+MCTPWrapper::EndpointHandle::EndpointHandle(
+    std::shared_ptr<internal::ResolvedEndpoint> resolved) :
+    endpoint(std::move(resolved))
+{
+}
+
+bool MCTPWrapper::EndpointHandle::isValid() const
+{
+    return endpoint && endpoint->impl;
+}
+
+DeviceID MCTPWrapper::EndpointHandle::getDeviceID() const
+{
+    return endpoint ? endpoint->deviceId : DeviceID(0, 0);
+}
+
+void MCTPWrapper::EndpointHandle::sendReceiveAsync(
+    ReceiveCallback receiveCb, const ByteArray& request,
+    std::chrono::milliseconds timeout) const
+{
+    sendReceiveAsync(std::move(receiveCb), request, timeout, Priority::normal);
+}
+
+void MCTPWrapper::EndpointHandle::sendReceiveAsync(
+    ReceiveCallback receiveCb, const ByteArray& request,
+    std::chrono::milliseconds timeout, Priority priority) const
+{
+    if (!isValid())
+    {
+        ByteArray response;
+        if (receiveCb)
+        {
+            receiveCb(boost::system::errc::make_error_code(
+                          boost::system::errc::io_error),
+                      response);
+        }
+        return;
+    }
+    endpoint->impl->sendReceiveAsync(std::move(receiveCb), *endpoint, request,
+                                     timeout, priority);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::EndpointHandle::sendReceiveYield(
+        boost::asio::yield_context yield, const ByteArray& request,
+        std::chrono::milliseconds timeout) const
+{
+    return sendReceiveYield(yield, request, timeout, Priority::normal);
+}
+
+std::pair<boost::system::error_code, ByteArray>
+    MCTPWrapper::EndpointHandle::sendReceiveYield(
+        boost::asio::yield_context yield, const ByteArray& request,
+        std::chrono::milliseconds timeout, Priority priority) const
+{
+    if (!isValid())
+    {
+        return std::make_pair(
+            boost::system::errc::make_error_code(boost::system::errc::io_error),
+            ByteArray());
+    }
+    return endpoint->impl->sendReceiveYield(yield, *endpoint, request,
+                                            timeout, priority);
+}
+
+void MCTPWrapper::EndpointHandle::sendAsync(const SendCallback& callback,
+                                            const uint8_t msgTag,
+                                            const bool tagOwner,
+                                            const ByteArray& request) const
+{
+    if (!isValid())
+    {
+        if (callback)
+        {
+            callback(boost::system::errc::make_error_code(
+                         boost::system::errc::io_error),
+                     -1);
+        }
+        return;
+    }
+    endpoint->impl->sendAsync(callback, *endpoint, msgTag, tagOwner, request);
+}
+
+std::pair<boost::system::error_code, int>
+    MCTPWrapper::EndpointHandle::sendYield(boost::asio::yield_context& yield,
+                                           const uint8_t msgTag,
+                                           const bool tagOwner,
+                                           const ByteArray& request) const
+{
+    if (!isValid())
+    {
+        return std::make_pair(
+            boost::system::errc::make_error_code(boost::system::errc::io_error),
+            -1);
+    }
+    return endpoint->impl->sendYield(yield, *endpoint, msgTag, tagOwner,
+                                     request);
+}
+
 std::optional<std::string> MCTPWrapper::getDeviceLocation(const eid_t eid)
 {
     return pimpl->getDeviceLocation(DeviceID(eid, 0));
@@ -239,6 +522,13 @@ std::optional<std::string> MCTPWrapper::getDeviceLocation(const DeviceID extende
     return pimpl->getDeviceLocation(extendedEID);
 }
 
+std::optional<std::string>
+    MCTPWrapper::getDeviceLocation(boost::asio::yield_context yield,
+                                   const DeviceID extendedEID)
+{
+    return pimpl->getDeviceLocation(yield, extendedEID);
+}
+
 void MCTPWrapper::getOwnEIDs(OwnEIDChangeCallback callback)
 {
     pimpl->getOwnEIDs(callback);
@@ -248,4 +538,77 @@ void MCTPWrapper::setExtendedReceiveCallback(
     ExtendedReceiveMessageCallback callback)
 {
     pimpl->setExtendedReceiveCallback(callback);
+}
+
+void MCTPWrapper::setSpanReceiveCallback(ReceiveMessageSpanCallback callback)
+{
+    pimpl->setSpanReceiveCallback(std::move(callback));
+}
+
+std::shared_ptr<ByteArray>
+    MCTPWrapper::retainPayload(std::span<const uint8_t> payload)
+{
+    return pimpl->retainPayload(payload);
+}
+
+void MCTPWrapper::sendReceiveManyAsync(
+    std::span<const SendReceiveTarget> targets,
+    const SendReceiveManyOptions& options,
+    SendReceiveManyResultCallback resultCb,
+    SendReceiveManyCompleteCallback completeCb)
+{
+    pimpl->sendReceiveManyAsync(targets, options, std::move(resultCb),
+                                std::move(completeCb));
+}
+
+void MCTPWrapper::sendReceiveManyAsync(
+    std::span<const DeviceID> devIDs, ByteSpan request,
+    const SendReceiveManyOptions& options,
+    SendReceiveManyResultCallback resultCb,
+    SendReceiveManyCompleteCallback completeCb)
+{
+    pimpl->sendReceiveManyAsync(devIDs, request, options, std::move(resultCb),
+                                std::move(completeCb));
+}
+
+std::vector<SendReceiveResult>
+    MCTPWrapper::sendReceiveMany(boost::asio::yield_context yield,
+                                 std::span<const SendReceiveTarget> targets,
+                                 const SendReceiveManyOptions& options,
+                                 SendReceiveManyResultCallback resultCb)
+{
+    return pimpl->sendReceiveMany(yield, targets, options,
+                                  std::move(resultCb));
+}
+
+std::vector<SendReceiveResult>
+    MCTPWrapper::sendReceiveMany(boost::asio::yield_context yield,
+                                 std::span<const DeviceID> devIDs,
+                                 ByteSpan request,
+                                 const SendReceiveManyOptions& options,
+                                 SendReceiveManyResultCallback resultCb)
+{
+    return pimpl->sendReceiveMany(yield, devIDs, request, options,
+                                  std::move(resultCb));
+}
+
+void MCTPWrapper::setBreakerStateCallback(BreakerStateCallback callback)
+{
+    pimpl->setBreakerStateCallback(std::move(callback));
+}
+
+BreakerState MCTPWrapper::getBreakerState(DeviceID devID) const
+{
+    return pimpl->getBreakerState(devID);
+}
+
+FlapStatistics MCTPWrapper::getFlapStatistics(DeviceID devID) const
+{
+    return pimpl->getFlapStatistics(devID);
+}
+
+void MCTPWrapper::setBatchReconfigurationCallback(
+    BatchReconfigurationCallback callback)
+{
+    pimpl->setBatchReconfigurationCallback(std::move(callback));
 }
\ No newline at end of file
@@ -19,17 +19,29 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <sdbusplus/asio/connection.hpp>
+#include <span>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace mctpw
 {
 class MCTPImpl;
+namespace internal
+{
+struct ResolvedEndpoint;
+} // namespace internal
 /// MCTP Endpoint Id
 using eid_t = uint8_t;
 using ByteArray = std::vector<uint8_t>;
+/// Contiguous part of an MCTP payload
+using ByteSpan = std::span<const uint8_t>;
+/// MCTP payload made of several parts. Parts are sent back to back as one
+/// message
+using ByteSpanList = std::span<const ByteSpan>;
 using NetworkID = uint8_t;
 using LocalEID = eid_t;
 
@@ -126,6 +138,90 @@ enum class MessageType : uint8_t
     vdiana = 0x7F,
 };
 
+/**
+ * @brief Scheduling class of a request. Requests of a higher class are sent
+ * first when requests wait for an endpoint or a service. Lower classes still
+ * make progress under sustained higher class load
+ */
+enum class Priority : uint8_t
+{
+    realtime,
+    normal,
+    bulk
+};
+
+/**
+ * @brief State of the circuit breaker of an endpoint. Requests to an endpoint
+ * with open breaker fail immediately with host_unreachable
+ */
+enum class BreakerState : uint8_t
+{
+    closed,
+    open,
+    halfOpen
+};
+
+/**
+ * @brief Add/remove counters of an endpoint kept by flap detection
+ */
+struct FlapStatistics
+{
+    /// Add and remove events seen
+    uint64_t transitions = 0;
+    /// Events not reported because the endpoint was quarantined
+    uint64_t suppressedEvents = 0;
+    /// Number of times the endpoint was quarantined
+    unsigned quarantines = 0;
+    /// Endpoint is quarantined now
+    bool quarantined = false;
+};
+
+/**
+ * @brief Selects sendReceive requests whose responses can be cached.
+ *
+ * A request matches when its leading bytes, masked with headerMask, equal
+ * header masked the same way. header starts with the message type byte.
+ * Bits set in volatileMask, for example the PLDM instance id, are left out of
+ * the cache key. They are copied from the request into the cached response
+ * when it is served.
+ */
+struct ResponseCacheRule
+{
+    ByteArray header;
+    /// Missing mask bytes are treated as 0xFF
+    ByteArray headerMask;
+    ByteArray volatileMask;
+    std::chrono::milliseconds ttl;
+};
+
+/**
+ * @brief Retry behaviour of sendReceive requests.
+ *
+ * A failed attempt whose error is listed in retryable is sent again after a
+ * backoff, until maxAttempts are used. Backoff starts at initialBackoff and
+ * grows by backoffMultiplier up to maxBackoff. Each backoff is varied randomly
+ * by up to jitter of its length. With hedge set, a second copy of the request
+ * is sent when no response arrived within the p95 latency of the endpoint.
+ * At most one copy is sent per request and it does not count against
+ * maxAttempts, so hedge works with maxAttempts 1 too. Use hedge only for
+ * requests safe to execute twice.
+ */
+struct RetryPolicy
+{
+    /// Attempts including the first one. 1 disables retries
+    unsigned maxAttempts = 1;
+    std::chrono::milliseconds initialBackoff{10};
+    std::chrono::milliseconds maxBackoff{1000};
+    double backoffMultiplier = 2.0;
+    /// Fraction 0..1 of the backoff varied randomly
+    double jitter = 0.2;
+    std::vector<boost::system::errc::errc_t> retryable{
+        boost::system::errc::timed_out, boost::system::errc::io_error,
+        boost::system::errc::device_or_resource_busy,
+        boost::system::errc::resource_unavailable_try_again};
+    bool hedge = false;
+};
+
 /**
  * @brief Configuration values to create MCTPWrapper
  *
@@ -192,6 +288,70 @@ struct MCTPConfiguration
     std::optional<uint16_t> vendorId = std::nullopt;
     std::optional<VendorMessageType> vendorMessageType = std::nullopt;
 
+    /// Maximum number of mctp services queried in parallel during endpoint
+    /// discovery. 0 means all services are queried at once
+    size_t discoveryFanOut = 8;
+
+    /// File to persist discovered endpoints. When set, endpoint discovery
+    /// serves endpoints from this file and verifies them against D-Bus in
+    /// background. Empty means snapshot is disabled
+    std::string snapshotPath{};
+
+    /// Maximum number of sendReceive requests outstanding to a single
+    /// endpoint. Further requests wait in a FIFO queue. 0 means no limit
+    size_t maxInFlightPerEndpoint = 0;
+    /// Maximum number of requests waiting for a single endpoint. Requests
+    /// beyond this fail with no_buffer_space
+    size_t maxQueuedPerEndpoint = 32;
+    /// Maximum number of sendReceive requests outstanding to a single mctp
+    /// service. Endpoints with reserved bandwidth are not counted against
+    /// it. 0 means no limit
+    size_t maxInFlightPerService = 0;
+    /// Attach a sendReceive request to an identical one already outstanding
+    /// to the same endpoint instead of sending it again. All callers get the
+    /// response of the single request
+    bool coalesceRequests = false;
+    /// Responses of requests matching one of these rules are cached for the
+    /// rule's ttl. Cached responses of a DeviceID are dropped when it is
+    /// added or removed
+    std::vector<ResponseCacheRule> responseCacheRules{};
+    /// Maximum bytes held by the response cache. Least recently used
+    /// responses are dropped first
+    size_t responseCacheSize = 64 * 1024;
+    /// Derive sendReceive timeout of each DeviceID from measured round trip
+    /// times. Timeout passed by the caller stays the upper bound
+    bool adaptiveTimeout = false;
+    /// Lower bound of the adaptive timeout
+    std::chrono::milliseconds adaptiveTimeoutMin{10};
+    /// Retry policy of sendReceive requests which are not given one. Retries
+    /// are disabled by default
+    RetryPolicy retryPolicy{};
+    /// Consecutive failed sendReceive requests after which requests to the
+    /// endpoint fail immediately. 0 disables circuit breakers
+    unsigned breakerFailureThreshold = 0;
+    /// Time a breaker stays open before a single probe request is let through
+    std::chrono::milliseconds breakerOpenTime{5000};
+    /// Time endpoints of an mctp service which left the bus are kept as stale.
+    /// If the service returns in time, only endpoints which really changed
+    /// are reported. 0 reports removal at once
+    std::chrono::milliseconds staleHoldTime{0};
+    /// Maximum number of mctpd signals kept while endpoint discovery is in
+    /// progress. They are replayed once discovery completes. If more arrive,
+    /// discovery is run again after the replay. 0 drops them
+    size_t preDiscoveryEventLimit = 256;
+    /// Network change events are collected for this long and delivered
+    /// together. An endpoint added and removed within the window is not
+    /// reported. 0 delivers every event at once
+    std::chrono::milliseconds eventBatchWindow{0};
+    /// Number of add or remove events within flapWindow after which an
+    /// endpoint is quarantined and its events are no longer reported.
+    /// 0 disables flap detection
+    unsigned flapThreshold = 0;
+    std::chrono::milliseconds flapWindow{60000};
+    /// Time a quarantined endpoint must stay unchanged. Then its state is
+    /// reported again if it differs from the one reported last
+    std::chrono::milliseconds flapHoldDown{30000};
+
     /**
      * @brief Set vendor id. Input values are expected to be in CPU byte order
      *
@@ -244,11 +404,51 @@ struct OwnEIDChange
 
 using ReconfigurationCallback =
     std::function<void(void*, const Event&, boost::asio::yield_context& yield)>;
+/* Events of one bulk change, e.g. all endpoints of a lost mctp service */
+using BatchReconfigurationCallback = std::function<void(
+    void*, std::span<const Event>, boost::asio::yield_context& yield)>;
 using ReceiveMessageCallback =
     std::function<void(void*, eid_t, bool, uint8_t, const ByteArray&, int)>;
 using ExtendedReceiveMessageCallback =
     std::function<void(void*, DeviceID, bool, uint8_t, const ByteArray&, int)>;
+/* Payload span is valid only until the callback returns */
+using ReceiveMessageSpanCallback = std::function<void(
+    void*, DeviceID, bool, uint8_t, std::span<const uint8_t>, int)>;
 using OwnEIDChangeCallback = std::function<void(OwnEIDChange&)>;
+using BreakerStateCallback =
+    std::function<void(void*, DeviceID, BreakerState)>;
+
+/**
+ * @brief Destination and request bytes of one sendReceiveMany request
+ */
+struct SendReceiveTarget
+{
+    DeviceID devID;
+    ByteSpan request;
+};
+
+/**
+ * @brief Outcome of one sendReceiveMany request
+ */
+struct SendReceiveResult
+{
+    DeviceID devID;
+    boost::system::error_code ec;
+    ByteArray response;
+};
+
+struct SendReceiveManyOptions
+{
+    /// Maximum number of requests outstanding at once. 0 means no limit
+    size_t concurrency = 0;
+    /// MCTP receive timeout of each request
+    std::chrono::milliseconds timeout{100};
+    /// Time allowed for the whole batch. Requests not completed by then end
+    /// with timed_out. 0 means no deadline
+    std::chrono::milliseconds deadline{0};
+    /// Scheduling class of the requests
+    Priority priority = Priority::normal;
+};
 
 /**
  * @brief Wrapper class to access MCTP functionalities
@@ -268,6 +468,128 @@ class MCTPWrapper
     using ReceiveCallback =
         std::function<void(boost::system::error_code, ByteArray&)>;
     using SendCallback = std::function<void(boost::system::error_code, int)>;
+    /* Invoked as each request of sendReceiveMany completes */
+    using SendReceiveManyResultCallback =
+        std::function<void(size_t index, SendReceiveResult& result)>;
+    /* Invoked once all requests of sendReceiveMany are complete. Results are
+     * in the order of the targets */
+    using SendReceiveManyCompleteCallback =
+        std::function<void(std::vector<SendReceiveResult>& results)>;
+    /* Invoked with context pointer and endpoints found on one service */
+    using DiscoveryBatchCallback =
+        std::function<void(void*, const EndpointMapExtended&)>;
+
+    /**
+     * @brief Endpoint resolved once to its mctp service for repeated traffic.
+     *
+     * Send functions of a handle skip the endpoint map lookup. A handle
+     * becomes invalid when the endpoint is removed or its mctp service goes
+     * away, and its send functions then fail with io_error like send
+     * functions of MCTPWrapper do for unknown endpoints. Get a new handle
+     * after the endpoint is added back. Handles must be used on the
+     * io_context of the MCTPWrapper which created them.
+     */
+    class EndpointHandle
+    {
+      public:
+        EndpointHandle() = default;
+
+        /**
+         * @brief Check if endpoint is still available
+         */
+        bool isValid() const;
+        /**
+         * @brief Get DeviceID the handle is resolved for
+         */
+        DeviceID getDeviceID() const;
+
+        /**
+         * @brief Send request to the endpoint and receive response
+         * asynchronously in receiveCb
+         *
+         * @param receiveCb Callback to be executed when response is ready
+         * @param request MCTP request byte array
+         * @param timeout MCTP receive timeout
+         */
+        void sendReceiveAsync(ReceiveCallback receiveCb,
+                              const ByteArray& request,
+                              std::chrono::milliseconds timeout) const;
+        /**
+         * @brief Send request to the endpoint with given priority class and
+         * receive response asynchronously in receiveCb
+         *
+         * @param receiveCb Callback to be executed when response is ready
+         * @param request MCTP request byte array
+         * @param timeout MCTP receive timeout
+         * @param priority Scheduling class of the request
+         */
+        void sendReceiveAsync(ReceiveCallback receiveCb,
+                              const ByteArray& request,
+                              std::chrono::milliseconds timeout,
+                              Priority priority) const;
+        /**
+         * @brief Send request to the endpoint and receive response using
+         * yield_context
+         *
+         * @param yield Boost yield_context to use on dbus call
+         * @param request MCTP request byte array
+         * @param timeout MCTP receive timeout
+         * @return std::pair<boost::system::error_code, ByteArray> Pair of
+         * boost error code and response byte array
+         */
+        std::pair<boost::system::error_code, ByteArray>
+            sendReceiveYield(boost::asio::yield_context yield,
+                             const ByteArray& request,
+                             std::chrono::milliseconds timeout) const;
+        /**
+         * @brief Send request to the endpoint with given priority class and
+         * receive response using yield_context
+         *
+         * @param yield Boost yield_context to use on dbus call
+         * @param request MCTP request byte array
+         * @param timeout MCTP receive timeout
+         * @param priority Scheduling class of the request
+         * @return std::pair<boost::system::error_code, ByteArray> Pair of
+         * boost error code and response byte array
+         */
+        std::pair<boost::system::error_code, ByteArray>
+            sendReceiveYield(boost::asio::yield_context yield,
+                             const ByteArray& request,
+                             std::chrono::milliseconds timeout,
+                             Priority priority) const;
+        /**
+         * @brief Send MCTP request to the endpoint and receive status of
+         * send operation in callback
+         *
+         * @param callback Callback that will be invoked with status of send
+         * operation
+         * @param msgTag MCTP message tag value
+         * @param tagOwner MCTP tag owner bit
+         * @param request MCTP request byte array
+         */
+        void sendAsync(const SendCallback& callback, const uint8_t msgTag,
+                       const bool tagOwner, const ByteArray& request) const;
+        /**
+         * @brief Send MCTP request to the endpoint and receive status of
+         * send operation
+         *
+         * @param yield boost yield_context object to yield on dbus calls
+         * @param msgTag MCTP message tag value
+         * @param tagOwner MCTP tag owner bit
+         * @param request MCTP request byte array
+         * @return std::pair<boost::system::error_code, int> Pair of boost
+         * error_code and dbus send method call return value
+         */
+        std::pair<boost::system::error_code, int>
+            sendYield(boost::asio::yield_context& yield, const uint8_t msgTag,
+                      const bool tagOwner, const ByteArray& request) const;
+
+      private:
+        friend class MCTPWrapper;
+        explicit EndpointHandle(
+            std::shared_ptr<internal::ResolvedEndpoint> resolved);
+        std::shared_ptr<internal::ResolvedEndpoint> endpoint;
+    };
 
     /**
      * @brief Construct a new MCTPWrapper object
@@ -317,6 +639,19 @@ class MCTPWrapper
      * status of the operation
      */
     void detectMctpEndpointsAsync(StatusCallback&& callback);
+    /**
+     * @brief Progressive variant of detectMctpEndpointsAsync. Endpoints of
+     * each mctp service are reported through batchCallback as soon as the
+     * service is scanned and can be used with send receive functions right
+     * away. callback is invoked after all the services are scanned.
+     *
+     * @param callback Callback to be invoked after mctp endpoint detection with
+     * status of the operation
+     * @param batchCallback Callback to be invoked with endpoints of each
+     * service
+     */
+    void detectMctpEndpointsAsync(StatusCallback&& callback,
+                                  DiscoveryBatchCallback batchCallback);
     /**
      * @brief This method or its async variant must be called before accessing
      * any send receive functions. It scan and detect all mctp endpoints exposed
@@ -327,6 +662,19 @@ class MCTPWrapper
      */
     boost::system::error_code
         detectMctpEndpoints(boost::asio::yield_context yield);
+    /**
+     * @brief Progressive variant of detectMctpEndpoints. Endpoints of each
+     * mctp service are reported through batchCallback as soon as the service
+     * is scanned and can be used with send receive functions right away.
+     *
+     * @param yield boost yield_context object to yield on dbus calls
+     * @param batchCallback Callback to be invoked with endpoints of each
+     * service
+     * @return boost::system::error_code
+     */
+    boost::system::error_code
+        detectMctpEndpoints(boost::asio::yield_context yield,
+                            DiscoveryBatchCallback batchCallback);
     /**
      * @brief Get a reference to internaly maintained EndpointMap without
      * network id
@@ -337,6 +685,10 @@ class MCTPWrapper
     /**
      * @brief Get a reference to internaly maintained EndpointMap
      *
+     * The map is built from the endpoint table when requested. Its contents
+     * are refreshed only by calling this function again, for example from
+     * the network change callback
+     *
      * @return EndpointMapExtended
      */
     const EndpointMapExtended& getEndpointMapExtended();
@@ -417,6 +769,37 @@ class MCTPWrapper
     void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
                           const ByteArray& request,
                           std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request to devID with given priority class and receive
+     * response asynchronously in receiveCb
+     *
+     * @param receiveCb Callback to be executed when response is ready
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request byte array
+     * @param timeout MCTP receive timeout
+     * @param priority Scheduling class of the request
+     */
+    void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          const ByteArray& request,
+                          std::chrono::milliseconds timeout,
+                          Priority priority);
+    /**
+     * @brief Send request to devID, retrying as given by policy, and receive
+     * response asynchronously in receiveCb
+     *
+     * @param receiveCb Callback to be executed when response is ready or all
+     * attempts failed
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request byte array
+     * @param timeout MCTP receive timeout of each attempt
+     * @param policy Retry and hedging policy
+     * @param priority Scheduling class of the request
+     */
+    void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          const ByteArray& request,
+                          std::chrono::milliseconds timeout,
+                          const RetryPolicy& policy,
+                          Priority priority = Priority::normal);
 
     /**
      * @brief Send request to dstEId and receive response using yield_context
@@ -446,6 +829,42 @@ class MCTPWrapper
         sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
                          const ByteArray& request,
                          std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request to devID with given priority class and receive
+     * response using yield_context
+     *
+     * @param yield Boost yield_context to use on dbus call
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request byte array
+     * @param timeout MCTP receive timeout
+     * @param priority Scheduling class of the request
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                         const ByteArray& request,
+                         std::chrono::milliseconds timeout,
+                         Priority priority);
+    /**
+     * @brief Send request to devID, retrying as given by policy, and receive
+     * response using yield_context
+     *
+     * @param yield Boost yield_context to use on dbus call
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request byte array
+     * @param timeout MCTP receive timeout of each attempt
+     * @param policy Retry and hedging policy
+     * @param priority Scheduling class of the request
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array of the last attempt
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                         const ByteArray& request,
+                         std::chrono::milliseconds timeout,
+                         const RetryPolicy& policy,
+                         Priority priority = Priority::normal);
 
     /**
      * @brief Send request to dstEId and receive response using
@@ -533,6 +952,309 @@ class MCTPWrapper
                   const uint8_t msgTag, const bool tagOwner,
                   const ByteArray& request);
 
+    /*
+     * Variants of the send functions above taking the request as a span or as
+     * a list of spans. Request bytes are copied directly into the dbus
+     * message, so the spans need to stay valid only during the call. Use
+     * ByteSpanList to send a header and a body from separate buffers without
+     * joining them first.
+     */
+    /**
+     * @brief Send request to devID and receive response asynchronously in
+     * receiveCb
+     *
+     * @param receiveCb Callback to be executed when response is ready
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request bytes
+     * @param timeout MCTP receive timeout
+     */
+    void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          ByteSpan request, std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request parts to devID as one message and receive response
+     * asynchronously in receiveCb
+     *
+     * @param receiveCb Callback to be executed when response is ready
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout MCTP receive timeout
+     */
+    void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          ByteSpanList request,
+                          std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request parts to devID as one message with given priority
+     * class and receive response asynchronously in receiveCb
+     *
+     * @param receiveCb Callback to be executed when response is ready
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout MCTP receive timeout
+     * @param priority Scheduling class of the request
+     */
+    void sendReceiveAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          ByteSpanList request,
+                          std::chrono::milliseconds timeout, Priority priority);
+    /**
+     * @brief Send request to devID and receive response using yield_context
+     *
+     * @param yield Boost yield_context to use on dbus call
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request bytes
+     * @param timeout MCTP receive timeout
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                         ByteSpan request, std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request parts to devID as one message and receive response
+     * using yield_context
+     *
+     * @param yield Boost yield_context to use on dbus call
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout MCTP receive timeout
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                         ByteSpanList request,
+                         std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request parts to devID as one message with given priority
+     * class and receive response using yield_context
+     *
+     * @param yield Boost yield_context to use on dbus call
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout MCTP receive timeout
+     * @param priority Scheduling class of the request
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveYield(boost::asio::yield_context yield, DeviceID devID,
+                         ByteSpanList request,
+                         std::chrono::milliseconds timeout, Priority priority);
+    /**
+     * @brief Send request to devID and receive response using a blocked call
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request bytes
+     * @param timeout MCTP receive timeout
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveBlocked(DeviceID devID, ByteSpan request,
+                           std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request parts to devID as one message and receive response
+     * using a blocked call
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout MCTP receive timeout
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendReceiveBlocked(DeviceID devID, ByteSpanList request,
+                           std::chrono::milliseconds timeout);
+    /**
+     * @brief Send MCTP request to devID and receive status of send operation
+     * in callback
+     *
+     * @param callback Callback that will be invoked with status of send
+     * operation
+     * @param devID Destination MCTP Device ID
+     * @param msgTag MCTP message tag value
+     * @param tagOwner MCTP tag owner bit
+     * @param request MCTP request bytes
+     */
+    void sendAsync(const SendCallback& callback, const DeviceID devID,
+                   const uint8_t msgTag, const bool tagOwner,
+                   ByteSpan request);
+    /**
+     * @brief Send MCTP request parts to devID as one message and receive
+     * status of send operation in callback
+     *
+     * @param callback Callback that will be invoked with status of send
+     * operation
+     * @param devID Destination MCTP Device ID
+     * @param msgTag MCTP message tag value
+     * @param tagOwner MCTP tag owner bit
+     * @param request MCTP request parts
+     */
+    void sendAsync(const SendCallback& callback, const DeviceID devID,
+                   const uint8_t msgTag, const bool tagOwner,
+                   ByteSpanList request);
+    /**
+     * @brief Send MCTP request to devID and receive status of send operation
+     *
+     * @param yield boost yield_context object to yield on dbus calls
+     * @param devID Destination MCTP Device ID
+     * @param msgTag MCTP message tag value
+     * @param tagOwner MCTP tag owner bit
+     * @param request MCTP request bytes
+     * @return std::pair<boost::system::error_code, int> Pair of boost
+     * error_code and dbus send method call return value
+     */
+    std::pair<boost::system::error_code, int>
+        sendYield(boost::asio::yield_context& yield, const DeviceID devID,
+                  const uint8_t msgTag, const bool tagOwner, ByteSpan request);
+    /**
+     * @brief Send MCTP request parts to devID as one message and receive
+     * status of send operation
+     *
+     * @param yield boost yield_context object to yield on dbus calls
+     * @param devID Destination MCTP Device ID
+     * @param msgTag MCTP message tag value
+     * @param tagOwner MCTP tag owner bit
+     * @param request MCTP request parts
+     * @return std::pair<boost::system::error_code, int> Pair of boost
+     * error_code and dbus send method call return value
+     */
+    std::pair<boost::system::error_code, int>
+        sendYield(boost::asio::yield_context& yield, const DeviceID devID,
+                  const uint8_t msgTag, const bool tagOwner,
+                  ByteSpanList request);
+
+    /**
+     * @brief Send request to devID and receive the matching response
+     * asynchronously in receiveCb. Message tag is allocated by the library
+     * from 8 tags available per device, so several requests can be
+     * outstanding to the same device. Response is matched from received
+     * messages and it is not passed to receive callbacks.
+     *
+     * Tags are only unique within this process. mctpd allocates its own tags
+     * for sendReceive requests, and other processes talking to the same
+     * device receive the same messages. A message with the right tag is
+     * taken as the response only if it matches the request: same message
+     * type, and for PLDM the same instance id, type and command, for SPDM the
+     * matching response code. Use unique PLDM instance ids. Since mctpd may
+     * consume a response whose tag matches one of its own pending requests,
+     * avoid mixing these requests with sendReceive to the same device. The
+     * tag of a timed out request is not reused for another timeout.
+     *
+     * @param receiveCb Callback to be executed when response is ready.
+     * Invoked with timed_out if response is not received within timeout and
+     * with resource_unavailable_try_again if all tags of devID are in use
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request byte array
+     * @param timeout Time to wait for response
+     */
+    void sendRequestAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          const ByteArray& request,
+                          std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request parts to devID as one message with a library
+     * managed message tag and receive the matching response asynchronously in
+     * receiveCb
+     *
+     * @param receiveCb Callback to be executed when response is ready
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout Time to wait for response
+     */
+    void sendRequestAsync(ReceiveCallback receiveCb, DeviceID devID,
+                          ByteSpanList request,
+                          std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request to devID with a library managed message tag and
+     * receive the matching response using yield_context
+     *
+     * @param yield Boost yield_context to use
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request byte array
+     * @param timeout Time to wait for response
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendRequestYield(boost::asio::yield_context yield, DeviceID devID,
+                         const ByteArray& request,
+                         std::chrono::milliseconds timeout);
+    /**
+     * @brief Send request parts to devID as one message with a library
+     * managed message tag and receive the matching response using
+     * yield_context
+     *
+     * @param yield Boost yield_context to use
+     * @param devID Destination MCTP Device ID
+     * @param request MCTP request parts
+     * @param timeout Time to wait for response
+     * @return std::pair<boost::system::error_code, ByteArray> Pair of boost
+     * error code and response byte array
+     */
+    std::pair<boost::system::error_code, ByteArray>
+        sendRequestYield(boost::asio::yield_context yield, DeviceID devID,
+                         ByteSpanList request,
+                         std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Send a request to each target and receive responses
+     * asynchronously. Requests are spread across mctp services in round robin
+     * order. Request bytes are copied, targets need to be valid only during
+     * this call
+     *
+     * @param targets Destination and request of each request
+     * @param options Concurrency limit, timeouts and priority
+     * @param resultCb Callback invoked as each request completes. Can be null
+     * @param completeCb Callback invoked with all results. Can be null
+     */
+    void sendReceiveManyAsync(std::span<const SendReceiveTarget> targets,
+                              const SendReceiveManyOptions& options,
+                              SendReceiveManyResultCallback resultCb,
+                              SendReceiveManyCompleteCallback completeCb);
+    /**
+     * @brief Send the same request to each of devIDs and receive responses
+     * asynchronously. Request bytes are copied once
+     *
+     * @param devIDs Destination MCTP Device IDs
+     * @param request MCTP request bytes
+     * @param options Concurrency limit, timeouts and priority
+     * @param resultCb Callback invoked as each request completes. Can be null
+     * @param completeCb Callback invoked with all results. Can be null
+     */
+    void sendReceiveManyAsync(std::span<const DeviceID> devIDs,
+                              ByteSpan request,
+                              const SendReceiveManyOptions& options,
+                              SendReceiveManyResultCallback resultCb,
+                              SendReceiveManyCompleteCallback completeCb);
+    /**
+     * @brief Send a request to each target and wait for all responses using
+     * yield_context
+     *
+     * @param yield Boost yield_context to use
+     * @param targets Destination and request of each request
+     * @param options Concurrency limit, timeouts and priority
+     * @param resultCb Callback invoked as each request completes. Can be null
+     * @return std::vector<SendReceiveResult> Results in the order of targets
+     */
+    std::vector<SendReceiveResult>
+        sendReceiveMany(boost::asio::yield_context yield,
+                        std::span<const SendReceiveTarget> targets,
+                        const SendReceiveManyOptions& options,
+                        SendReceiveManyResultCallback resultCb = nullptr);
+    /**
+     * @brief Send the same request to each of devIDs and wait for all
+     * responses using yield_context
+     *
+     * @param yield Boost yield_context to use
+     * @param devIDs Destination MCTP Device IDs
+     * @param request MCTP request bytes
+     * @param options Concurrency limit, timeouts and priority
+     * @param resultCb Callback invoked as each request completes. Can be null
+     * @return std::vector<SendReceiveResult> Results in the order of devIDs
+     */
+    std::vector<SendReceiveResult>
+        sendReceiveMany(boost::asio::yield_context yield,
+                        std::span<const DeviceID> devIDs, ByteSpan request,
+                        const SendReceiveManyOptions& options,
+                        SendReceiveManyResultCallback resultCb = nullptr);
+
     /**
      * @brief Register a responder application with MCTP layer
      * @param version The version supported by the responder. Use if only one
@@ -563,12 +1285,34 @@ class MCTPWrapper
      * @brief Get human-readable device location string by EID
      *
      * When device location string is not available or it is an empty string,
-     * will return std::nullopt.
+     * will return std::nullopt. This is a blocking call.
      *
      * @param eid MCTP Endpoint ID of the device to query
      * @return std::optional<std::string> Optional device location string
      */
     std::optional<std::string> getDeviceLocation(const DeviceID eid);
+    /**
+     * @brief Get human-readable device location string by EID without
+     * blocking the io_context. Prefer this over the blocking variants.
+     *
+     * When device location string is not available or it is an empty string,
+     * will return std::nullopt.
+     *
+     * @param yield boost yield_context object to yield on dbus calls
+     * @param eid MCTP Endpoint ID of the device to query
+     * @return std::optional<std::string> Optional device location string
+     */
+    std::optional<std::string> getDeviceLocation(boost::asio::yield_context yield,
+                                                 const DeviceID eid);
+
+    /**
+     * @brief Get a handle to send messages to an endpoint repeatedly without
+     * looking it up on every call
+     *
+     * @param eid MCTP Device ID
+     * @return EndpointHandle Handle which is invalid if eid is not detected
+     */
+    EndpointHandle getEndpointHandle(const DeviceID eid);
 
     /**
      * @brief Get own eid on each available mctp services
@@ -591,6 +1335,60 @@ class MCTPWrapper
      */
     void setExtendedReceiveCallback(ExtendedReceiveMessageCallback callback);
 
+    /**
+     * @brief This callback will be executed when an mctp message is received
+     * with tagowner not set and there is no pending request in mctpd queue.
+     * Unlike other receive callbacks the payload is not copied into a
+     * ByteArray. The span points into the dbus message and is valid only
+     * until the callback returns. Use retainPayload to keep it longer.
+     * Can be used together with the other receive callbacks.
+     * @param callback Callback function
+     */
+    void setSpanReceiveCallback(ReceiveMessageSpanCallback callback);
+
+    /**
+     * @brief This callback will be executed when the circuit breaker of an
+     * endpoint changes state. Enabled by breakerFailureThreshold in
+     * MCTPConfiguration
+     * @param callback Callback function
+     */
+    void setBreakerStateCallback(BreakerStateCallback callback);
+
+    /**
+     * @brief This callback will be executed with all events of a bulk change,
+     * for example removal of every endpoint of an mctp service which left the
+     * bus, or all events of one MCTPConfiguration::eventBatchWindow. When not
+     * set, such events go one by one to the network change callback
+     * @param callback Callback function
+     */
+    void setBatchReconfigurationCallback(BatchReconfigurationCallback callback);
+
+    /**
+     * @brief Get circuit breaker state of an endpoint
+     * @param devID MCTP Device ID
+     * @return BreakerState::closed unless requests to devID are being refused
+     * or probed
+     */
+    BreakerState getBreakerState(DeviceID devID) const;
+
+    /**
+     * @brief Get flap detection counters of an endpoint. Enabled by
+     * flapThreshold in MCTPConfiguration
+     * @param devID MCTP Device ID
+     * @return FlapStatistics Counters. All zero for endpoints not quarantined
+     * and without events within flapWindow
+     */
+    FlapStatistics getFlapStatistics(DeviceID devID) const;
+
+    /**
+     * @brief Copy a payload received in span receive callback into a buffer
+     * which stays valid as long as the returned pointer is held. Buffers are
+     * reused from a pool once released.
+     * @param payload Payload span passed to the callback
+     * @return std::shared_ptr<ByteArray> Buffer holding a copy of payload
+     */
+    std::shared_ptr<ByteArray> retainPayload(std::span<const uint8_t> payload);
+
     /// MCTP Configuration to store message type and vendor defined properties
     MCTPConfiguration config{};
 
@@ -0,0 +1,328 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "request_scheduler.hpp"
+
+#include <algorithm>
+
+namespace mctpw
+{
+namespace internal
+{
+RequestScheduler::RequestScheduler(const MCTPConfiguration& config) :
+    maxInFlightPerEndpoint(config.maxInFlightPerEndpoint),
+    maxQueuedPerEndpoint(config.maxQueuedPerEndpoint),
+    maxInFlightPerService(config.maxInFlightPerService)
+{
+}
+
+RequestScheduler::Admission
+    RequestScheduler::submit(const RequestPtr& request)
+{
+    EndpointQueue& queue = endpoints[request->devID];
+    if (queue.service != request->service && queue.active.empty() &&
+        queue.waitingCount == 0 && !queue.blockedOnService)
+    {
+        // Endpoint may have moved to another service, e.g. restarted mctpd
+        queue.service = request->service;
+    }
+    if (queue.waitingCount == 0 && endpointHasCapacity(queue) &&
+        serviceHasCapacity(request->devID, queue.service))
+    {
+        activate(queue, request);
+        return Admission::started;
+    }
+    if (queue.waitingCount >= maxQueuedPerEndpoint)
+    {
+        releaseEndpoint(request->devID);
+        return Admission::rejected;
+    }
+
+    queue.waiting[static_cast<size_t>(request->priority)].emplace_back(
+        request);
+    ++queue.waitingCount;
+    if (endpointHasCapacity(queue) && !queue.blockedOnService)
+    {
+        // Only the service limit holds it back
+        queue.blockedOnService = true;
+        services[queue.service].blocked.emplace_back(request->devID);
+    }
+    return Admission::queued;
+}
+
+bool RequestScheduler::finish(const RequestPtr& request)
+{
+    if (request->finished)
+    {
+        return false;
+    }
+    request->finished = true;
+
+    auto it = endpoints.find(request->devID);
+    if (it == endpoints.end())
+    {
+        return true;
+    }
+    EndpointQueue& queue = it->second;
+    if (queue.active.erase(request) == 0)
+    {
+        // Finished while waiting
+        auto& waiting = queue.waiting[static_cast<size_t>(request->priority)];
+        auto pos = std::find(waiting.begin(), waiting.end(), request);
+        if (pos != waiting.end())
+        {
+            waiting.erase(pos);
+            --queue.waitingCount;
+        }
+    }
+    else if (request->countsOnService)
+    {
+        auto service = services.find(queue.service);
+        if (service != services.end() && service->second.inFlight > 0)
+        {
+            --service->second.inFlight;
+        }
+    }
+    dirty.emplace_back(request->devID, queue.service);
+    if (!dispatching)
+    {
+        dispatch();
+    }
+    return true;
+}
+
+void RequestScheduler::setServiceLimitBypass(DeviceID devID, bool bypass)
+{
+    if (!bypass)
+    {
+        serviceLimitBypass.erase(devID);
+        return;
+    }
+    serviceLimitBypass.emplace(devID);
+    auto it = endpoints.find(devID);
+    if (it != endpoints.end() && it->second.blockedOnService)
+    {
+        dirty.emplace_back(devID, it->second.service);
+        if (!dispatching)
+        {
+            dispatch();
+        }
+    }
+}
+
+std::vector<RequestScheduler::RequestPtr>
+    RequestScheduler::requestsOf(const std::string& service) const
+{
+    std::vector<RequestPtr> waiting;
+    std::vector<RequestPtr> active;
+    for (const auto& [devID, queue] : endpoints)
+    {
+        if (queue.service != service)
+        {
+            continue;
+        }
+        for (const auto& requests : queue.waiting)
+        {
+            waiting.insert(waiting.end(), requests.begin(), requests.end());
+        }
+        active.insert(active.end(), queue.active.begin(), queue.active.end());
+    }
+    waiting.insert(waiting.end(), active.begin(), active.end());
+    return waiting;
+}
+
+bool RequestScheduler::endpointHasCapacity(const EndpointQueue& queue) const
+{
+    return maxInFlightPerEndpoint == 0 ||
+           queue.active.size() < maxInFlightPerEndpoint;
+}
+
+bool RequestScheduler::serviceHasCapacity(DeviceID devID,
+                                          const std::string& service) const
+{
+    if (maxInFlightPerService == 0 || serviceLimitBypass.contains(devID))
+    {
+        return true;
+    }
+    auto it = services.find(service);
+    return it == services.end() || it->second.inFlight < maxInFlightPerService;
+}
+
+void RequestScheduler::activate(EndpointQueue& queue,
+                                const RequestPtr& request)
+{
+    queue.active.emplace(request);
+    if (maxInFlightPerService != 0 &&
+        !serviceLimitBypass.contains(request->devID))
+    {
+        ++services[queue.service].inFlight;
+        request->countsOnService = true;
+    }
+}
+
+size_t RequestScheduler::selectClass(EndpointQueue& queue, bool take) const
+{
+    size_t highest = 0;
+    while (highest < priorityCount && queue.waiting[highest].empty())
+    {
+        ++highest;
+    }
+    size_t selected = highest;
+    // Starved lower class goes first. Lowest class is checked first since
+    // it waits the longest under load
+    for (size_t cls = priorityCount - 1; cls > highest; --cls)
+    {
+        if (!queue.waiting[cls].empty() &&
+            queue.bypassed[cls] >= maxPriorityBypass)
+        {
+            selected = cls;
+            break;
+        }
+    }
+    if (take)
+    {
+        for (size_t cls = selected + 1; cls < priorityCount; ++cls)
+        {
+            if (!queue.waiting[cls].empty())
+            {
+                ++queue.bypassed[cls];
+            }
+        }
+        queue.bypassed[selected] = 0;
+    }
+    return selected;
+}
+
+void RequestScheduler::dispatch()
+{
+    dispatching = true;
+    while (!dirty.empty())
+    {
+        auto [devID, service] = std::move(dirty.front());
+        dirty.pop_front();
+        dispatchEndpoint(devID, false);
+        dispatchService(service);
+        releaseEndpoint(devID);
+    }
+    dispatching = false;
+}
+
+bool RequestScheduler::dispatchEndpoint(DeviceID devID, bool single)
+{
+    bool started = false;
+    auto it = endpoints.find(devID);
+    if (it == endpoints.end())
+    {
+        return started;
+    }
+    // Elements of unordered_map stay in place when other endpoints are
+    // added by start. This entry is not erased while it has active requests
+    EndpointQueue& queue = it->second;
+    while (queue.waitingCount > 0 && endpointHasCapacity(queue))
+    {
+        if (!serviceHasCapacity(devID, queue.service))
+        {
+            if (!queue.blockedOnService)
+            {
+                queue.blockedOnService = true;
+                services[queue.service].blocked.emplace_back(devID);
+            }
+            break;
+        }
+        auto& waiting = queue.waiting[selectClass(queue, true)];
+        auto next = std::move(waiting.front());
+        waiting.pop_front();
+        --queue.waitingCount;
+        activate(queue, next);
+        started = true;
+        auto start = std::move(next->start);
+        if (start)
+        {
+            start(next);
+        }
+        if (single)
+        {
+            break;
+        }
+    }
+    return started;
+}
+
+void RequestScheduler::dispatchService(const std::string& service)
+{
+    auto it = services.find(service);
+    if (it == services.end())
+    {
+        return;
+    }
+    while (!it->second.blocked.empty() &&
+           (maxInFlightPerService == 0 ||
+            it->second.inFlight < maxInFlightPerService))
+    {
+        // Serve the endpoint with the most urgent waiting request. Ties go
+        // to the endpoint blocked first
+        auto& blocked = it->second.blocked;
+        auto best = blocked.end();
+        size_t bestClass = priorityCount;
+        for (auto candidate = blocked.begin(); candidate != blocked.end();
+             ++candidate)
+        {
+            auto queue = endpoints.find(*candidate);
+            if (queue == endpoints.end() || queue->second.waitingCount == 0)
+            {
+                best = candidate;
+                break;
+            }
+            size_t cls = selectClass(queue->second, false);
+            if (cls < bestClass)
+            {
+                bestClass = cls;
+                best = candidate;
+            }
+        }
+        DeviceID devID = *best;
+        blocked.erase(best);
+        auto queue = endpoints.find(devID);
+        if (queue != endpoints.end())
+        {
+            queue->second.blockedOnService = false;
+            dispatchEndpoint(devID, true);
+        }
+        releaseEndpoint(devID);
+        // start may add services. Look it up again
+        it = services.find(service);
+        if (it == services.end())
+        {
+            return;
+        }
+    }
+    if (it->second.inFlight == 0 && it->second.blocked.empty())
+    {
+        services.erase(it);
+    }
+}
+
+void RequestScheduler::releaseEndpoint(DeviceID devID)
+{
+    auto it = endpoints.find(devID);
+    if (it != endpoints.end() && it->second.active.empty() &&
+        it->second.waitingCount == 0 && !it->second.blockedOnService)
+    {
+        endpoints.erase(it);
+    }
+}
+} // namespace internal
+} // namespace mctpw
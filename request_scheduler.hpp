@@ -0,0 +1,131 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "mctp_wrapper.hpp"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace mctpw
+{
+namespace internal
+{
+/**
+ * @brief Decides when sendReceive requests may be sent.
+ *
+ * Requests are queued per DeviceID, one FIFO queue per priority class.
+ * Higher classes are served first. A waiting lower class request is served
+ * after it has been passed over maxPriorityBypass times, so bulk traffic
+ * keeps moving. Limits are applied per endpoint and per mctp service.
+ * Endpoints with reserved bandwidth are not limited by the service limit.
+ */
+class RequestScheduler
+{
+  public:
+    struct Request
+    {
+        DeviceID devID{};
+        /* Service the request is sent to. Key for per service limit, so
+         * callers must pass one name per service */
+        std::string service;
+        Priority priority = Priority::normal;
+        MCTPWrapper::ReceiveCallback callback;
+        /* Sends the request. Needed only for queued requests */
+        std::function<void(const std::shared_ptr<Request>&)> start;
+        /* Set once finished. Response arriving after that is dropped */
+        bool finished = false;
+        /* Set by scheduler when request counts against the service limit */
+        bool countsOnService = false;
+    };
+    using RequestPtr = std::shared_ptr<Request>;
+
+    enum class Admission
+    {
+        /* Request is active and must be sent right away by the caller */
+        started,
+        /* Request is queued. Caller must set start before returning */
+        queued,
+        /* Queue is full */
+        rejected
+    };
+
+    explicit RequestScheduler(const MCTPConfiguration& config);
+
+    Admission submit(const RequestPtr& request);
+    /**
+     * @brief Mark request finished and start waiting requests which are
+     * allowed to run now. Safe to call from start of another request.
+     *
+     * @return false if request was already finished
+     */
+    bool finish(const RequestPtr& request);
+    void setServiceLimitBypass(DeviceID devID, bool bypass);
+    /* Waiting and active requests sent to service, waiting ones first */
+    std::vector<RequestPtr> requestsOf(const std::string& service) const;
+
+  private:
+    static constexpr size_t priorityCount = 3;
+    static constexpr unsigned maxPriorityBypass = 4;
+
+    struct EndpointQueue
+    {
+        std::string service;
+        std::unordered_set<RequestPtr> active;
+        std::array<std::deque<RequestPtr>, priorityCount> waiting;
+        std::array<unsigned, priorityCount> bypassed{};
+        size_t waitingCount = 0;
+        /* Waiting only because of the service limit */
+        bool blockedOnService = false;
+    };
+    struct ServiceState
+    {
+        size_t inFlight = 0;
+        std::vector<DeviceID> blocked;
+    };
+
+    size_t maxInFlightPerEndpoint;
+    size_t maxQueuedPerEndpoint;
+    size_t maxInFlightPerService;
+    std::unordered_map<DeviceID, EndpointQueue> endpoints;
+    std::unordered_map<std::string, ServiceState> services;
+    std::unordered_set<DeviceID> serviceLimitBypass;
+    /* Endpoints to dispatch. Filled by finish, drained by the outermost call */
+    std::deque<std::pair<DeviceID, std::string>> dirty;
+    bool dispatching = false;
+
+    bool endpointHasCapacity(const EndpointQueue& queue) const;
+    bool serviceHasCapacity(DeviceID devID, const std::string& service) const;
+    void activate(EndpointQueue& queue, const RequestPtr& request);
+    // Class to serve next. Counts passed over classes when take is set
+    size_t selectClass(EndpointQueue& queue, bool take) const;
+    void dispatch();
+    // Start waiting requests of devID as long as limits allow. Returns true
+    // if a request was started
+    bool dispatchEndpoint(DeviceID devID, bool single);
+    void dispatchService(const std::string& service);
+    void releaseEndpoint(DeviceID devID);
+};
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,154 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "response_cache.hpp"
+
+namespace mctpw
+{
+namespace internal
+{
+ResponseCache::ResponseCache(const MCTPConfiguration& config) :
+    rules(config.responseCacheRules), maxSize(config.responseCacheSize)
+{
+}
+
+std::optional<ResponseCache::Key>
+    ResponseCache::keyOf(DeviceID devID, ByteSpan request) const
+{
+    for (size_t rule = 0; rule < rules.size(); rule++)
+    {
+        const auto& header = rules[rule].header;
+        const auto& mask = rules[rule].headerMask;
+        if (request.size() < header.size())
+        {
+            continue;
+        }
+        bool matching = true;
+        for (size_t i = 0; i < header.size() && matching; i++)
+        {
+            uint8_t m = i < mask.size() ? mask[i] : 0xFF;
+            matching = (request[i] & m) == (header[i] & m);
+        }
+        if (!matching)
+        {
+            continue;
+        }
+
+        Key key;
+        key.devID = devID;
+        key.rule = rule;
+        auto generation = generations.find(devID);
+        if (generation != generations.end())
+        {
+            key.generation = generation->second;
+        }
+        key.bytes.reserve(sizeof(devID.id) + request.size());
+        key.bytes.append(reinterpret_cast<const char*>(&devID.id),
+                         sizeof(devID.id));
+        const auto& volatileMask = rules[rule].volatileMask;
+        for (size_t i = 0; i < request.size(); i++)
+        {
+            uint8_t m = i < volatileMask.size() ? volatileMask[i] : 0;
+            key.bytes.push_back(static_cast<char>(request[i] & ~m));
+        }
+        return key;
+    }
+    return std::nullopt;
+}
+
+std::optional<ByteArray> ResponseCache::find(const Key& key, ByteSpan request)
+{
+    auto it = index.find(key.bytes);
+    if (it == index.end())
+    {
+        return std::nullopt;
+    }
+    if (std::chrono::steady_clock::now() >= it->second->expiry)
+    {
+        erase(it->second);
+        return std::nullopt;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+
+    ByteArray response = it->second->response;
+    const auto& volatileMask = rules[key.rule].volatileMask;
+    for (size_t i = 0;
+         i < volatileMask.size() && i < response.size() && i < request.size();
+         i++)
+    {
+        uint8_t m = volatileMask[i];
+        response[i] = static_cast<uint8_t>((response[i] & ~m) |
+                                           (request[i] & m));
+    }
+    return response;
+}
+
+void ResponseCache::insert(const Key& key, const ByteArray& response)
+{
+    auto generation = generations.find(key.devID);
+    uint32_t current =
+        generation != generations.end() ? generation->second : 0;
+    if (key.generation != current)
+    {
+        return;
+    }
+
+    auto existing = index.find(key.bytes);
+    if (existing != index.end())
+    {
+        erase(existing->second);
+    }
+    Entry entry{key.bytes, key.devID, response,
+                std::chrono::steady_clock::now() + rules[key.rule].ttl};
+    if (cost(entry) > maxSize)
+    {
+        return;
+    }
+    size += cost(entry);
+    entries.emplace_front(std::move(entry));
+    index.emplace(entries.front().key, entries.begin());
+    while (size > maxSize)
+    {
+        erase(std::prev(entries.end()));
+    }
+}
+
+void ResponseCache::invalidate(DeviceID devID)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    ++generations[devID];
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto next = std::next(it);
+        if (it->devID == devID)
+        {
+            erase(it);
+        }
+        it = next;
+    }
+}
+
+void ResponseCache::erase(Lru::iterator it)
+{
+    size -= cost(*it);
+    index.erase(it->key);
+    entries.erase(it);
+}
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,102 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "mctp_wrapper.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mctpw
+{
+namespace internal
+{
+/**
+ * @brief LRU cache of sendReceive responses selected by ResponseCacheRule.
+ *
+ * Entries expire after the ttl of the rule which admitted them. Total size
+ * of keys and responses is kept under a byte limit.
+ */
+class ResponseCache
+{
+  public:
+    struct Key
+    {
+        /* DeviceID and request bytes with volatile bits cleared */
+        std::string bytes;
+        DeviceID devID{};
+        size_t rule = 0;
+        /* Generation of devID when the request was made. Responses to
+         * requests made before invalidation are not stored */
+        uint32_t generation = 0;
+    };
+
+    explicit ResponseCache(const MCTPConfiguration& config);
+
+    bool enabled() const
+    {
+        return !rules.empty() && maxSize > 0;
+    }
+    /**
+     * @brief Build cache key of request
+     *
+     * @return Key or std::nullopt if no rule matches request
+     */
+    std::optional<Key> keyOf(DeviceID devID, ByteSpan request) const;
+    /**
+     * @brief Find unexpired response for key
+     *
+     * @return Copy of the response with volatile bits taken from request
+     */
+    std::optional<ByteArray> find(const Key& key, ByteSpan request);
+    void insert(const Key& key, const ByteArray& response);
+    /* Drop all responses of devID */
+    void invalidate(DeviceID devID);
+
+  private:
+    /* Bookkeeping cost of an entry counted against maxSize */
+    static constexpr size_t entryOverhead = 64;
+
+    struct Entry
+    {
+        std::string key;
+        DeviceID devID{};
+        ByteArray response;
+        std::chrono::steady_clock::time_point expiry;
+    };
+    using Lru = std::list<Entry>;
+
+    std::vector<ResponseCacheRule> rules;
+    size_t maxSize;
+    size_t size = 0;
+    /* Most recently used first */
+    Lru entries;
+    std::unordered_map<std::string, Lru::iterator> index;
+    std::unordered_map<DeviceID, uint32_t> generations;
+
+    static size_t cost(const Entry& entry)
+    {
+        return entry.key.size() + entry.response.size() + entryOverhead;
+    }
+    void erase(Lru::iterator it);
+};
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,97 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "rtt_estimator.hpp"
+
+#include <algorithm>
+
+namespace mctpw
+{
+namespace internal
+{
+RttEstimator::RttEstimator(const MCTPConfiguration& config) :
+    adaptive(config.adaptiveTimeout), minTimeout(config.adaptiveTimeoutMin)
+{
+}
+
+std::chrono::milliseconds
+    RttEstimator::timeout(DeviceID devID, std::chrono::milliseconds cap) const
+{
+    if (!adaptive)
+    {
+        return cap;
+    }
+    auto it = stats.find(devID);
+    if (it == stats.end())
+    {
+        return cap;
+    }
+    return std::min(
+        std::chrono::ceil<std::chrono::milliseconds>(it->second.rto), cap);
+}
+
+void RttEstimator::addSample(DeviceID devID, std::chrono::microseconds rtt)
+{
+    auto [it, inserted] = stats.try_emplace(devID);
+    Stats& entry = it->second;
+    if (inserted)
+    {
+        entry.srtt = rtt;
+        entry.rttvar = rtt / 2;
+    }
+    else
+    {
+        auto delta = entry.srtt > rtt ? entry.srtt - rtt : rtt - entry.srtt;
+        entry.rttvar = (3 * entry.rttvar + delta) / 4;
+        entry.srtt = (7 * entry.srtt + rtt) / 8;
+    }
+    entry.rto = std::clamp(entry.srtt + std::max(granularity, 4 * entry.rttvar),
+                           minTimeout, maxTimeout);
+    entry.samples[entry.sampled++ % sampleCount] = static_cast<uint32_t>(
+        std::min<std::chrono::microseconds::rep>(rtt.count(), UINT32_MAX));
+}
+
+void RttEstimator::onTimeout(DeviceID devID)
+{
+    auto it = stats.find(devID);
+    if (it != stats.end())
+    {
+        it->second.rto = std::min(2 * it->second.rto, maxTimeout);
+    }
+}
+
+std::optional<std::chrono::microseconds>
+    RttEstimator::percentile(DeviceID devID, double fraction) const
+{
+    auto it = stats.find(devID);
+    if (it == stats.end() || it->second.sampled < minPercentileSamples)
+    {
+        return std::nullopt;
+    }
+    size_t count = std::min(it->second.sampled, sampleCount);
+    std::array<uint32_t, sampleCount> sorted = it->second.samples;
+    size_t rank = std::min(count - 1, static_cast<size_t>(fraction * count));
+    std::nth_element(sorted.begin(), sorted.begin() + rank,
+                     sorted.begin() + count);
+    return std::chrono::microseconds(sorted[rank]);
+}
+
+void RttEstimator::erase(DeviceID devID)
+{
+    stats.erase(devID);
+}
+} // namespace internal
+} // namespace mctpw
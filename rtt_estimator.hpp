@@ -0,0 +1,86 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+#pragma once
+
+#include "mctp_wrapper.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+namespace mctpw
+{
+namespace internal
+{
+/**
+ * @brief Per DeviceID round trip time statistics and retransmission timeout
+ * computed as in RFC 6298.
+ *
+ * SRTT and RTTVAR are updated with gains 1/8 and 1/4. Timeout is
+ * SRTT + max(G, 4 * RTTVAR), doubled for every timeout seen until the next
+ * sample. Recent samples are kept to estimate latency percentiles.
+ */
+class RttEstimator
+{
+  public:
+    explicit RttEstimator(const MCTPConfiguration& config);
+
+    /**
+     * @brief Timeout to use for next request to devID. cap unless adaptive
+     * timeout is enabled
+     *
+     * @param cap Timeout given by caller. Upper bound of the result and the
+     * result while devID has no samples
+     */
+    std::chrono::milliseconds timeout(DeviceID devID,
+                                      std::chrono::milliseconds cap) const;
+    void addSample(DeviceID devID, std::chrono::microseconds rtt);
+    void onTimeout(DeviceID devID);
+    /**
+     * @brief Latency below which the given fraction of recent samples of
+     * devID fall
+     *
+     * @return std::nullopt until enough samples are collected
+     */
+    std::optional<std::chrono::microseconds> percentile(DeviceID devID,
+                                                        double fraction) const;
+    /* Forget statistics of devID, e.g. when the endpoint is replaced */
+    void erase(DeviceID devID);
+
+  private:
+    static constexpr std::chrono::microseconds granularity{1000};
+    static constexpr std::chrono::microseconds maxTimeout{65535000};
+    static constexpr size_t sampleCount = 32;
+    static constexpr size_t minPercentileSamples = 8;
+
+    struct Stats
+    {
+        std::chrono::microseconds srtt{};
+        std::chrono::microseconds rttvar{};
+        std::chrono::microseconds rto{};
+        /* Ring of recent samples */
+        std::array<uint32_t, sampleCount> samples{};
+        size_t sampled = 0;
+    };
+
+    bool adaptive;
+    std::chrono::microseconds minTimeout;
+    std::unordered_map<DeviceID, Stats> stats;
+};
+} // namespace internal
+} // namespace mctpw
@@ -0,0 +1,165 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "circuit_breaker.hpp"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using mctpw::BreakerState;
+using mctpw::DeviceID;
+using mctpw::MCTPConfiguration;
+using mctpw::internal::CircuitBreakers;
+
+class CircuitBreakerTest : public ::testing::Test
+{
+  protected:
+    CircuitBreakerTest()
+    {
+        config.breakerFailureThreshold = 3;
+        config.breakerOpenTime = 0ms;
+    }
+
+    void watch(CircuitBreakers& breakers)
+    {
+        breakers.stateChangeCallback = [this](DeviceID devID,
+                                              BreakerState state) {
+            changes.emplace_back(devID, state);
+        };
+    }
+
+    MCTPConfiguration config;
+    const DeviceID devID{8, 0};
+    std::vector<std::pair<DeviceID, BreakerState>> changes;
+};
+
+TEST_F(CircuitBreakerTest, Disabled)
+{
+    config.breakerFailureThreshold = 0;
+    CircuitBreakers breakers(config);
+    for (int i = 0; i < 10; i++)
+    {
+        breakers.onFailure(devID);
+    }
+    EXPECT_TRUE(breakers.allow(devID));
+    EXPECT_EQ(breakers.state(devID), BreakerState::closed);
+}
+
+TEST_F(CircuitBreakerTest, OpenHalfOpenClosed)
+{
+    CircuitBreakers breakers(config);
+    watch(breakers);
+
+    breakers.onFailure(devID);
+    breakers.onFailure(devID);
+    EXPECT_EQ(breakers.state(devID), BreakerState::closed);
+    breakers.onFailure(devID);
+    EXPECT_EQ(breakers.state(devID), BreakerState::open);
+
+    // openTime passed, single probe let through
+    EXPECT_TRUE(breakers.allow(devID));
+    EXPECT_EQ(breakers.state(devID), BreakerState::halfOpen);
+    EXPECT_FALSE(breakers.allow(devID));
+
+    breakers.onSuccess(devID);
+    EXPECT_EQ(breakers.state(devID), BreakerState::closed);
+    EXPECT_TRUE(breakers.allow(devID));
+
+    std::vector<std::pair<DeviceID, BreakerState>> expected{
+        {devID, BreakerState::open},
+        {devID, BreakerState::halfOpen},
+        {devID, BreakerState::closed}};
+    EXPECT_EQ(changes, expected);
+}
+
+TEST_F(CircuitBreakerTest, SuccessResetsFailures)
+{
+    CircuitBreakers breakers(config);
+    breakers.onFailure(devID);
+    breakers.onFailure(devID);
+    breakers.onSuccess(devID);
+    breakers.onFailure(devID);
+    breakers.onFailure(devID);
+    EXPECT_EQ(breakers.state(devID), BreakerState::closed);
+}
+
+TEST_F(CircuitBreakerTest, OpenRefusesUntilOpenTime)
+{
+    config.breakerOpenTime = 1h;
+    CircuitBreakers breakers(config);
+    for (int i = 0; i < 3; i++)
+    {
+        breakers.onFailure(devID);
+    }
+    EXPECT_FALSE(breakers.allow(devID));
+    EXPECT_EQ(breakers.state(devID), BreakerState::open);
+    // Other endpoints are not affected
+    EXPECT_TRUE(breakers.allow(DeviceID(9, 0)));
+}
+
+TEST_F(CircuitBreakerTest, FailedProbeOpensAgain)
+{
+    CircuitBreakers breakers(config);
+    for (int i = 0; i < 3; i++)
+    {
+        breakers.onFailure(devID);
+    }
+    ASSERT_TRUE(breakers.allow(devID));
+    breakers.onFailure(devID);
+    EXPECT_EQ(breakers.state(devID), BreakerState::open);
+}
+
+TEST_F(CircuitBreakerTest, AbandonedProbeOpensAgain)
+{
+    CircuitBreakers breakers(config);
+    for (int i = 0; i < 3; i++)
+    {
+        breakers.onFailure(devID);
+    }
+    ASSERT_TRUE(breakers.allow(devID));
+    watch(breakers);
+    breakers.onAbandoned(devID);
+    EXPECT_EQ(breakers.state(devID), BreakerState::open);
+
+    // Next probe goes through
+    EXPECT_TRUE(breakers.allow(devID));
+    EXPECT_EQ(breakers.state(devID), BreakerState::halfOpen);
+
+    std::vector<std::pair<DeviceID, BreakerState>> expected{
+        {devID, BreakerState::open}, {devID, BreakerState::halfOpen}};
+    EXPECT_EQ(changes, expected);
+}
+
+TEST_F(CircuitBreakerTest, CallbackMayReenter)
+{
+    CircuitBreakers breakers(config);
+    for (int i = 0; i < 3; i++)
+    {
+        breakers.onFailure(devID);
+    }
+    ASSERT_TRUE(breakers.allow(devID));
+    BreakerState seen = BreakerState::open;
+    breakers.stateChangeCallback = [&](DeviceID id, BreakerState) {
+        seen = breakers.state(id);
+        breakers.erase(id);
+    };
+    breakers.onSuccess(devID);
+    EXPECT_EQ(seen, BreakerState::closed);
+}
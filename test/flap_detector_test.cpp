@@ -0,0 +1,150 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "flap_detector.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using mctpw::DeviceID;
+using mctpw::Event;
+using mctpw::MCTPConfiguration;
+using mctpw::internal::FlapDetector;
+using Verdict = FlapDetector::Verdict;
+
+class FlapDetectorTest : public ::testing::Test
+{
+  protected:
+    FlapDetectorTest()
+    {
+        config.flapThreshold = 3;
+        config.flapWindow = 1h;
+        config.flapHoldDown = 0ms;
+    }
+
+    Event event(Event::EventType type, DeviceID devID = DeviceID(8, 0))
+    {
+        return Event{type, devID.mctpEID(), devID};
+    }
+    Event added(DeviceID devID = DeviceID(8, 0))
+    {
+        return event(Event::EventType::deviceAdded, devID);
+    }
+    Event removed(DeviceID devID = DeviceID(8, 0))
+    {
+        return event(Event::EventType::deviceRemoved, devID);
+    }
+
+    MCTPConfiguration config;
+    const DeviceID devID{8, 0};
+};
+
+TEST_F(FlapDetectorTest, Disabled)
+{
+    config.flapThreshold = 0;
+    FlapDetector detector(config);
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(detector.onEvent(added()), Verdict::report);
+    }
+    EXPECT_EQ(detector.statistics(devID).transitions, 0);
+}
+
+TEST_F(FlapDetectorTest, QuarantineAndSuppress)
+{
+    config.flapHoldDown = 1h;
+    FlapDetector detector(config);
+    EXPECT_EQ(detector.onEvent(added()), Verdict::report);
+    EXPECT_EQ(detector.onEvent(removed()), Verdict::report);
+    EXPECT_EQ(detector.onEvent(added()), Verdict::quarantine);
+    EXPECT_EQ(detector.onEvent(removed()), Verdict::suppress);
+    // Other endpoints are not affected
+    EXPECT_EQ(detector.onEvent(added(DeviceID(9, 0))), Verdict::report);
+
+    // Hold down not elapsed
+    EXPECT_TRUE(detector.release().empty());
+    EXPECT_TRUE(detector.nextRelease());
+
+    auto stats = detector.statistics(devID);
+    EXPECT_EQ(stats.transitions, 4);
+    EXPECT_EQ(stats.suppressedEvents, 2);
+    EXPECT_EQ(stats.quarantines, 1);
+    EXPECT_TRUE(stats.quarantined);
+}
+
+TEST_F(FlapDetectorTest, ReleaseReportsChangedState)
+{
+    FlapDetector detector(config);
+    detector.onEvent(added());
+    detector.onEvent(removed());
+    ASSERT_EQ(detector.onEvent(added()), Verdict::quarantine);
+
+    // Removal was reported last, endpoint is back
+    auto events = detector.release();
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].type, Event::EventType::deviceAdded);
+    EXPECT_EQ(events[0].deviceId, devID);
+    EXPECT_FALSE(detector.statistics(devID).quarantined);
+    EXPECT_FALSE(detector.nextRelease());
+}
+
+TEST_F(FlapDetectorTest, ReleaseSilentForUnchangedState)
+{
+    FlapDetector detector(config);
+    detector.onEvent(added());
+    detector.onEvent(removed());
+    ASSERT_EQ(detector.onEvent(added()), Verdict::quarantine);
+    EXPECT_EQ(detector.onEvent(removed()), Verdict::suppress);
+
+    // Removal was reported last and is the latest state
+    EXPECT_TRUE(detector.release().empty());
+    EXPECT_FALSE(detector.statistics(devID).quarantined);
+}
+
+TEST_F(FlapDetectorTest, QuietEndpointsForgotten)
+{
+    config.flapWindow = 10ms;
+    FlapDetector detector(config);
+    detector.onEvent(added());
+    detector.onEvent(removed());
+    EXPECT_EQ(detector.statistics(devID).transitions, 2);
+
+    std::this_thread::sleep_for(20ms);
+    detector.release();
+    EXPECT_EQ(detector.statistics(devID).transitions, 0);
+
+    // Old events no longer count towards the threshold
+    EXPECT_EQ(detector.onEvent(added()), Verdict::report);
+    EXPECT_EQ(detector.statistics(devID).transitions, 1);
+}
+
+TEST_F(FlapDetectorTest, QuarantinedEndpointsKept)
+{
+    config.flapWindow = 10ms;
+    config.flapHoldDown = 1h;
+    FlapDetector detector(config);
+    detector.onEvent(added());
+    detector.onEvent(removed());
+    ASSERT_EQ(detector.onEvent(added()), Verdict::quarantine);
+
+    std::this_thread::sleep_for(20ms);
+    EXPECT_TRUE(detector.release().empty());
+    EXPECT_TRUE(detector.statistics(devID).quarantined);
+    EXPECT_EQ(detector.onEvent(removed()), Verdict::suppress);
+}
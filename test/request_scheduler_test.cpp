@@ -0,0 +1,181 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "request_scheduler.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using mctpw::DeviceID;
+using mctpw::MCTPConfiguration;
+using mctpw::Priority;
+using mctpw::internal::RequestScheduler;
+
+class RequestSchedulerTest : public ::testing::Test
+{
+  protected:
+    // Submit a request and record its name when it starts
+    RequestScheduler::RequestPtr submit(RequestScheduler& scheduler,
+                                        const std::string& name,
+                                        uint8_t eid = 8,
+                                        Priority priority = Priority::normal)
+    {
+        auto request = std::make_shared<RequestScheduler::Request>();
+        request->devID = DeviceID(eid, 0);
+        request->service = "xyz.openbmc_project.MCTP_SMBus_PCIe_slot";
+        request->priority = priority;
+        request->start = [this, name](const RequestScheduler::RequestPtr&) {
+            started.emplace_back(name);
+        };
+        lastAdmission = scheduler.submit(request);
+        if (lastAdmission == RequestScheduler::Admission::started)
+        {
+            started.emplace_back(name);
+        }
+        return request;
+    }
+
+    MCTPConfiguration config;
+    std::vector<std::string> started;
+    RequestScheduler::Admission lastAdmission{};
+};
+
+TEST_F(RequestSchedulerTest, EndpointLimit)
+{
+    config.maxInFlightPerEndpoint = 2;
+    config.maxQueuedPerEndpoint = 1;
+    RequestScheduler scheduler(config);
+
+    auto first = submit(scheduler, "first");
+    EXPECT_EQ(lastAdmission, RequestScheduler::Admission::started);
+    submit(scheduler, "second");
+    EXPECT_EQ(lastAdmission, RequestScheduler::Admission::started);
+    submit(scheduler, "third");
+    EXPECT_EQ(lastAdmission, RequestScheduler::Admission::queued);
+    submit(scheduler, "fourth");
+    EXPECT_EQ(lastAdmission, RequestScheduler::Admission::rejected);
+    // Other endpoints have their own limit
+    submit(scheduler, "other", 9);
+    EXPECT_EQ(lastAdmission, RequestScheduler::Admission::started);
+
+    EXPECT_TRUE(scheduler.finish(first));
+    EXPECT_EQ(started, (std::vector<std::string>{"first", "second", "other",
+                                                 "third"}));
+}
+
+TEST_F(RequestSchedulerTest, FifoWithinClass)
+{
+    config.maxInFlightPerEndpoint = 1;
+    RequestScheduler scheduler(config);
+
+    std::vector<RequestScheduler::RequestPtr> requests;
+    for (const char* name : {"a", "b", "c", "d"})
+    {
+        requests.emplace_back(submit(scheduler, name));
+    }
+    for (const auto& request : requests)
+    {
+        scheduler.finish(request);
+    }
+    EXPECT_EQ(started, (std::vector<std::string>{"a", "b", "c", "d"}));
+}
+
+TEST_F(RequestSchedulerTest, HigherClassFirstAndBulkPromoted)
+{
+    config.maxInFlightPerEndpoint = 1;
+    RequestScheduler scheduler(config);
+
+    std::map<std::string, RequestScheduler::RequestPtr> requests;
+    requests.emplace("active", submit(scheduler, "active"));
+    requests.emplace("bulk", submit(scheduler, "bulk", 8, Priority::bulk));
+    for (int i = 0; i < 6; i++)
+    {
+        std::string name = "rt" + std::to_string(i);
+        requests.emplace(name,
+                         submit(scheduler, name, 8, Priority::realtime));
+    }
+    // Finish the active request until all have run
+    while (started.size() < requests.size())
+    {
+        size_t count = started.size();
+        scheduler.finish(requests.at(started.back()));
+        ASSERT_EQ(started.size(), count + 1);
+    }
+    // Bulk goes after being passed over 4 times
+    EXPECT_EQ(started,
+              (std::vector<std::string>{"active", "rt0", "rt1", "rt2", "rt3",
+                                        "bulk", "rt4", "rt5"}));
+}
+
+TEST_F(RequestSchedulerTest, FinishWaitingRequest)
+{
+    config.maxInFlightPerEndpoint = 1;
+    RequestScheduler scheduler(config);
+
+    auto active = submit(scheduler, "active");
+    auto waiting = submit(scheduler, "waiting");
+    auto next = submit(scheduler, "next");
+
+    // E.g. cancelled or timed out while queued
+    EXPECT_TRUE(scheduler.finish(waiting));
+    EXPECT_FALSE(scheduler.finish(waiting));
+    EXPECT_TRUE(scheduler.finish(active));
+    EXPECT_EQ(started, (std::vector<std::string>{"active", "next"}));
+}
+
+TEST_F(RequestSchedulerTest, ServiceLimitBypass)
+{
+    config.maxInFlightPerService = 1;
+    RequestScheduler scheduler(config);
+
+    auto first = submit(scheduler, "first", 8);
+    submit(scheduler, "blocked", 9);
+    EXPECT_EQ(lastAdmission, RequestScheduler::Admission::queued);
+    EXPECT_EQ(started, (std::vector<std::string>{"first"}));
+
+    // Endpoint with reserved bandwidth is not held back by the service
+    scheduler.setServiceLimitBypass(DeviceID(9, 0), true);
+    EXPECT_EQ(started, (std::vector<std::string>{"first", "blocked"}));
+    submit(scheduler, "bypassing", 9);
+    EXPECT_EQ(lastAdmission, RequestScheduler::Admission::started);
+}
+
+TEST_F(RequestSchedulerTest, FinishFromStart)
+{
+    config.maxInFlightPerEndpoint = 1;
+    RequestScheduler scheduler(config);
+
+    auto active = submit(scheduler, "active");
+    // Request failing at once when started finishes from its start
+    auto failing = std::make_shared<RequestScheduler::Request>();
+    failing->devID = DeviceID(8, 0);
+    failing->service = "xyz.openbmc_project.MCTP_SMBus_PCIe_slot";
+    failing->start = [this, &scheduler](
+                         const RequestScheduler::RequestPtr& self) {
+        started.emplace_back("failing");
+        scheduler.finish(self);
+    };
+    EXPECT_EQ(scheduler.submit(failing),
+              RequestScheduler::Admission::queued);
+    submit(scheduler, "last");
+
+    scheduler.finish(active);
+    EXPECT_EQ(started,
+              (std::vector<std::string>{"active", "failing", "last"}));
+}
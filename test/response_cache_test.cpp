@@ -0,0 +1,132 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "response_cache.hpp"
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+using mctpw::ByteArray;
+using mctpw::ByteSpan;
+using mctpw::DeviceID;
+using mctpw::MCTPConfiguration;
+using mctpw::ResponseCacheRule;
+using mctpw::internal::ResponseCache;
+
+class ResponseCacheTest : public ::testing::Test
+{
+  protected:
+    ResponseCacheTest()
+    {
+        // PLDM request of type 2 command 4. Instance id is volatile
+        ResponseCacheRule rule;
+        rule.header = {0x01, 0x80, 0x02, 0x04};
+        rule.headerMask = {0xFF, 0x80, 0x3F, 0xFF};
+        rule.volatileMask = {0x00, 0x1F};
+        rule.ttl = std::chrono::hours(1);
+        config.responseCacheRules.emplace_back(rule);
+    }
+
+    MCTPConfiguration config;
+    const DeviceID devID{8, 0};
+};
+
+TEST_F(ResponseCacheTest, KeyIgnoresVolatileBits)
+{
+    ResponseCache cache(config);
+    ByteArray first = {0x01, 0x81, 0x02, 0x04, 0x09};
+    ByteArray second = {0x01, 0x85, 0x02, 0x04, 0x09};
+    ByteArray otherBody = {0x01, 0x81, 0x02, 0x04, 0x08};
+    ByteArray otherCommand = {0x01, 0x81, 0x02, 0x05, 0x09};
+
+    auto key = cache.keyOf(devID, first);
+    ASSERT_TRUE(key);
+    EXPECT_EQ(key->bytes, cache.keyOf(devID, second)->bytes);
+    EXPECT_NE(key->bytes, cache.keyOf(devID, otherBody)->bytes);
+    EXPECT_NE(key->bytes, cache.keyOf(DeviceID(9, 0), first)->bytes);
+    EXPECT_FALSE(cache.keyOf(devID, otherCommand));
+    EXPECT_FALSE(cache.keyOf(devID, ByteArray{0x01, 0x81}));
+}
+
+TEST_F(ResponseCacheTest, FindPatchesVolatileBits)
+{
+    ResponseCache cache(config);
+    ByteArray request = {0x01, 0x81, 0x02, 0x04};
+    ByteArray response = {0x01, 0x01, 0x02, 0x04, 0x00, 0xAA};
+    cache.insert(*cache.keyOf(devID, request), response);
+
+    ByteArray retried = {0x01, 0x85, 0x02, 0x04};
+    auto cached = cache.find(*cache.keyOf(devID, retried), retried);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(*cached, (ByteArray{0x01, 0x05, 0x02, 0x04, 0x00, 0xAA}));
+}
+
+TEST_F(ResponseCacheTest, ExpiredEntryNotFound)
+{
+    config.responseCacheRules.front().ttl = std::chrono::milliseconds(0);
+    ResponseCache cache(config);
+    ByteArray request = {0x01, 0x81, 0x02, 0x04};
+    auto key = *cache.keyOf(devID, request);
+    cache.insert(key, ByteArray{0x01, 0x01, 0x02, 0x04, 0x00});
+    EXPECT_FALSE(cache.find(key, request));
+}
+
+TEST_F(ResponseCacheTest, LeastRecentlyUsedEvicted)
+{
+    // Room for two entries: key of 4 + 4 bytes, response of 5 bytes and
+    // bookkeeping of 64 bytes each
+    config.responseCacheSize = 2 * (8 + 5 + 64);
+    ResponseCache cache(config);
+    ByteArray response = {0x01, 0x01, 0x02, 0x04, 0x00};
+    auto request = [](uint8_t id) {
+        return ByteArray{0x01, static_cast<uint8_t>(0x80 | id), 0x02, 0x04};
+    };
+    auto keyOf = [&](DeviceID dev) {
+        return *cache.keyOf(dev, request(0));
+    };
+
+    cache.insert(keyOf(DeviceID(10, 0)), response);
+    cache.insert(keyOf(DeviceID(11, 0)), response);
+    // Use the first one so the second is least recently used
+    EXPECT_TRUE(cache.find(keyOf(DeviceID(10, 0)), request(1)));
+    cache.insert(keyOf(DeviceID(12, 0)), response);
+
+    EXPECT_TRUE(cache.find(keyOf(DeviceID(10, 0)), request(2)));
+    EXPECT_FALSE(cache.find(keyOf(DeviceID(11, 0)), request(2)));
+    EXPECT_TRUE(cache.find(keyOf(DeviceID(12, 0)), request(2)));
+}
+
+TEST_F(ResponseCacheTest, InvalidateDropsEntriesAndStaleInserts)
+{
+    ResponseCache cache(config);
+    ByteArray request = {0x01, 0x81, 0x02, 0x04};
+    ByteArray response = {0x01, 0x01, 0x02, 0x04, 0x00};
+    auto key = *cache.keyOf(devID, request);
+    cache.insert(key, response);
+    // Request sent before the endpoint changed
+    auto staleKey = *cache.keyOf(devID, request);
+
+    cache.invalidate(devID);
+    EXPECT_FALSE(cache.find(key, request));
+
+    cache.insert(staleKey, response);
+    EXPECT_FALSE(cache.find(staleKey, request));
+
+    auto freshKey = *cache.keyOf(devID, request);
+    cache.insert(freshKey, response);
+    EXPECT_TRUE(cache.find(freshKey, request));
+}
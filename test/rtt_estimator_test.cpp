@@ -0,0 +1,127 @@
+/*
+// Copyright (c) 2021 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "rtt_estimator.hpp"
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+using mctpw::DeviceID;
+using mctpw::MCTPConfiguration;
+using mctpw::internal::RttEstimator;
+
+class RttEstimatorTest : public ::testing::Test
+{
+  protected:
+    RttEstimatorTest()
+    {
+        config.adaptiveTimeout = true;
+        config.adaptiveTimeoutMin = 10ms;
+    }
+
+    MCTPConfiguration config;
+    const DeviceID devID{8, 0};
+};
+
+TEST_F(RttEstimatorTest, CapWithoutSamplesOrAdaptiveTimeout)
+{
+    RttEstimator estimator(config);
+    EXPECT_EQ(estimator.timeout(devID, 1000ms), 1000ms);
+
+    config.adaptiveTimeout = false;
+    RttEstimator fixed(config);
+    fixed.addSample(devID, 100ms);
+    EXPECT_EQ(fixed.timeout(devID, 1000ms), 1000ms);
+}
+
+TEST_F(RttEstimatorTest, Rfc6298Update)
+{
+    RttEstimator estimator(config);
+    // SRTT = R, RTTVAR = R / 2, RTO = SRTT + 4 * RTTVAR
+    estimator.addSample(devID, 100ms);
+    EXPECT_EQ(estimator.timeout(devID, 1000ms), 300ms);
+    // RTTVAR = 3/4 * 50 + 1/4 * 0, SRTT = 7/8 * 100 + 1/8 * 100
+    estimator.addSample(devID, 100ms);
+    EXPECT_EQ(estimator.timeout(devID, 1000ms), 250ms);
+    // RTTVAR = 3/4 * 37.5 + 1/4 * 100, SRTT = 7/8 * 100 + 1/8 * 200
+    estimator.addSample(devID, 200ms);
+    EXPECT_EQ(estimator.timeout(devID, 1000ms), 112500us + 4 * 53125us);
+    // Result never exceeds the caller's timeout
+    EXPECT_EQ(estimator.timeout(devID, 200ms), 200ms);
+    // Other endpoints are not affected
+    EXPECT_EQ(estimator.timeout(DeviceID(9, 0), 1000ms), 1000ms);
+}
+
+TEST_F(RttEstimatorTest, TimeoutClamped)
+{
+    RttEstimator estimator(config);
+    estimator.addSample(devID, 100us);
+    EXPECT_EQ(estimator.timeout(devID, 1000ms), 10ms);
+
+    // mctpd takes at most 65535 ms
+    estimator.addSample(DeviceID(9, 0), 60s);
+    EXPECT_EQ(estimator.timeout(DeviceID(9, 0), 1h), 65535ms);
+}
+
+TEST_F(RttEstimatorTest, TimeoutDoublesUntilNextSample)
+{
+    RttEstimator estimator(config);
+    estimator.addSample(devID, 100ms);
+    estimator.onTimeout(devID);
+    EXPECT_EQ(estimator.timeout(devID, 10s), 600ms);
+    estimator.onTimeout(devID);
+    EXPECT_EQ(estimator.timeout(devID, 10s), 1200ms);
+    for (int i = 0; i < 10; i++)
+    {
+        estimator.onTimeout(devID);
+    }
+    EXPECT_EQ(estimator.timeout(devID, 1h), 65535ms);
+
+    estimator.addSample(devID, 100ms);
+    EXPECT_LT(estimator.timeout(devID, 1h), 1s);
+}
+
+TEST_F(RttEstimatorTest, Percentile)
+{
+    RttEstimator estimator(config);
+    for (int i = 1; i < 8; i++)
+    {
+        estimator.addSample(devID, std::chrono::milliseconds(i));
+    }
+    // Not enough samples yet
+    EXPECT_FALSE(estimator.percentile(devID, 0.5));
+
+    for (int i = 8; i <= 10; i++)
+    {
+        estimator.addSample(devID, std::chrono::milliseconds(i));
+    }
+    EXPECT_EQ(estimator.percentile(devID, 0.0), 1ms);
+    EXPECT_EQ(estimator.percentile(devID, 0.5), 6ms);
+    EXPECT_EQ(estimator.percentile(devID, 0.95), 10ms);
+    EXPECT_EQ(estimator.percentile(devID, 1.0), 10ms);
+
+    // Only the 32 most recent samples count
+    for (int i = 0; i < 32; i++)
+    {
+        estimator.addSample(devID, 50ms);
+    }
+    EXPECT_EQ(estimator.percentile(devID, 0.0), 50ms);
+
+    estimator.erase(devID);
+    EXPECT_FALSE(estimator.percentile(devID, 0.5));
+}
@@ -8,6 +8,7 @@ dbus-daemon --config-file=/usr/share/dbus-1/system.conf
 
 meson setup builddir -Dexamples=enabled --wipe
 meson compile -C builddir -v
+meson test -C builddir
 
 # Clean up
 git config --global --add safe.directory /root/local